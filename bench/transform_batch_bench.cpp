@@ -0,0 +1,107 @@
+#include "transform_batch.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/mat3x3.hpp"
+#include "glm/vec3.hpp"
+#include "glm/matrix.hpp"
+#include "glm/geometric.hpp"
+#include "glm/ext/matrix_transform.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstddef>
+
+// times transform_batch::normalMatrices against the per instance glm inverse it replaced
+// build with -DCMAKE_BUILD_TYPE=Release, unoptimized timings say nothing about either path
+namespace
+{
+	// best of this many runs is reported, the first run also pays for page faults
+	constexpr int num_runs = 5;
+
+	// affine models with rotation, non uniform scale and translation, the cases the kernel exists for
+	std::vector<glm::mat4> randomModels(const size_t count)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+		std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+
+		std::vector<glm::mat4> models(count);
+		for (glm::mat4& model : models) {
+			model = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng)));
+			model = glm::rotate(model, angle(rng), glm::normalize(glm::vec3(axis(rng), axis(rng), axis(rng)) + 0.01f));
+			model = glm::scale(model, glm::vec3(scale(rng), scale(rng), scale(rng)));
+		}
+		return models;
+	}
+
+	// the scalar single threaded path instance normal matrices were built with before the batch kernel
+	void glmNormalMatrices(const glm::mat4* models, glm::mat3* normal_mats, const size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			normal_mats[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+		}
+	}
+
+	template <typename Func>
+	double bestMilliseconds(const Func& func)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (int run = 0; run < num_runs; run++) {
+			const auto start = std::chrono::steady_clock::now();
+			func();
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+
+	// largest element difference relative to the element's size, both paths should agree to float precision
+	float maxRelativeError(const std::vector<glm::mat3>& one, const std::vector<glm::mat3>& two)
+	{
+		float error = 0.0f;
+		for (size_t i = 0; i < one.size(); i++) {
+			for (int col = 0; col < 3; col++) {
+				for (int row = 0; row < 3; row++) {
+					const float difference = std::abs(one[i][col][row] - two[i][col][row]);
+					error = std::max(error, difference / std::max(1.0f, std::abs(one[i][col][row])));
+				}
+			}
+		}
+		return error;
+	}
+}
+
+int main()
+{
+	std::cout << std::setw(10) << "instances" << std::setw(12) << "glm ms" << std::setw(12) << "batch ms"
+		<< std::setw(10) << "speedup" << std::setw(12) << "max error" << '\n';
+
+	for (const size_t count : {size_t(10'000), size_t(100'000), size_t(1'000'000)}) {
+		const std::vector<glm::mat4> models = randomModels(count);
+		std::vector<glm::mat3> glm_normals(count);
+		std::vector<glm::mat3> batch_normals(count);
+
+		const double glm_ms = bestMilliseconds([&]() {
+			glmNormalMatrices(models.data(), glm_normals.data(), count);
+		});
+		const double batch_ms = bestMilliseconds([&]() {
+			transform_batch::normalMatrices(models.data(), batch_normals.data(), count);
+		});
+
+		std::cout << std::setw(10) << count << std::fixed << std::setprecision(3)
+			<< std::setw(12) << glm_ms << std::setw(12) << batch_ms
+			<< std::setw(9) << std::setprecision(2) << (glm_ms / batch_ms) << 'x'
+			<< std::setw(12) << std::scientific << std::setprecision(1) << maxRelativeError(glm_normals, batch_normals)
+			<< std::defaultfloat << '\n';
+	}
+
+	return 0;
+}
@@ -6,6 +6,8 @@ in vec2 tex_coord;
 in vec4 light_space_pos;
 in vec4 norm;
 in vec4 frag_pos;
+flat in int atlas_tile;
+flat in int texture_layer;
 
 struct Material {
 	sampler2D texture_diffuse0;
@@ -16,14 +18,21 @@ struct Material {
 
 uniform sampler2D depth_map;
 uniform Material material;
-uniform mat3 light_normal_mat;
+uniform mat3 view_normal_mat;
 uniform mat4 view;
+// merged terrain faces span several blocks, repeat the face's atlas tile across them
+uniform bool atlas_tiling;
+// instanced blocks drawn together read their textures from arrays, one layer per BlockId
+uniform bool block_texture_arrays;
+uniform sampler2DArray block_diffuse;
+uniform sampler2DArray block_specular;
 
 float calc_attenuation(float light_distance, float constant, float linear, float quadratic);
 float calc_spotlight_intensity(vec4 frag_dir, vec4 light_dir, float inner_angle_cosine, float outer_angle_cosine);
 float calc_spotlight_intensity(vec3 frag_dir, vec3 light_dir, float inner_angle_cosine, float outer_angle_cosine);
 vec4 calc_light(vec4 light_pos, vec4 diffuse_tex, vec4 specular_tex, vec4 ambient_light, vec4 diffuse_light, vec4 specular_light, bool shadow);
 vec4 calc_light(vec3 light_pos, vec4 diffuse_tex, vec4 specular_tex, vec4 ambient_light, vec4 diffuse_light, vec4 specular_light, bool shadow);
+vec4 sample_block_texture(sampler2D tex);
 // check for zero errors
 vec4 better_normalize(vec4 in_vec);
 vec3 better_normalize(vec3 in_vec);
@@ -37,9 +46,9 @@ float better_dot(vec3 one, vec3 two);
 void main()
 {
 	// textures
-	const vec4 diffuse_tex = texture(material.texture_diffuse0, tex_coord);
-	const vec4 specular_tex = texture(material.texture_specular0, tex_coord);
-	const vec4 normal_tex = texture(material.texture_normal0, tex_coord);
+	const vec4 diffuse_tex = block_texture_arrays ? texture(block_diffuse, vec3(tex_coord, texture_layer)) : sample_block_texture(material.texture_diffuse0);
+	const vec4 specular_tex = block_texture_arrays ? texture(block_specular, vec3(tex_coord, texture_layer)) : sample_block_texture(material.texture_specular0);
+	const vec4 normal_tex = sample_block_texture(material.texture_normal0);
 
 	vec4 output_color = vec4(0.0);
 	for(int i=0; i<NUM_POINT_LIGHTS; i++) {
@@ -58,7 +67,7 @@ void main()
 	for (int i=0; i<NUM_SPOT_LIGHTS; i++) {
 		const SpotLight cur_light = spot_lights[i];
 
-		const vec4 light_dir = better_normalize(vec4(light_normal_mat * cur_light.dir.xyz, 0.0));
+		const vec4 light_dir = better_normalize(vec4(view_normal_mat * cur_light.dir.xyz, 0.0));
 		const vec4 light_pos = view * cur_light.pos;
 		const vec4 light_to_frag_dir = better_normalize(frag_pos - light_pos);
 		const float light_distance = distance(frag_pos, light_pos);
@@ -73,13 +82,26 @@ void main()
 	for(int i=0; i<NUM_DIRECTIONAL_LIGHTS; i++) {
 		DirectionalLight cur_light = directional_lights[i];
 
-		const vec4 light_dir = better_normalize(vec4(light_normal_mat * cur_light.dir.xyz, 0.0));
+		const vec4 light_dir = better_normalize(vec4(view_normal_mat * cur_light.dir.xyz, 0.0));
 		output_color += calc_light(light_dir, diffuse_tex, specular_tex, cur_light.color.ambient, cur_light.color.diffuse, cur_light.color.specular, true);
 	}
 
 	frag_color = output_color;
 }
 
+vec4 sample_block_texture(sampler2D tex) {
+	if (!atlas_tiling) {
+		return texture(tex, tex_coord);
+	}
+
+	// block textures stack three tiles vertically, wrap v inside the tile and use the
+	// unwrapped derivatives so mip selection doesn't jump at tile edges
+	const vec2 atlas_coord = vec2(tex_coord.x, (float(atlas_tile) + fract(tex_coord.y)) / 3.0);
+	const vec2 tex_coord_dx = dFdx(tex_coord) * vec2(1.0, 1.0 / 3.0);
+	const vec2 tex_coord_dy = dFdy(tex_coord) * vec2(1.0, 1.0 / 3.0);
+	return textureGrad(tex, atlas_coord, tex_coord_dx, tex_coord_dy);
+}
+
 float calc_attenuation(float light_distance, float constant, float linear, float quadratic) {
 	if ((constant != 0.0) ||
 		((light_distance != 0.0) &&
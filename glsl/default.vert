@@ -9,21 +9,41 @@ out vec2 tex_coord;
 out vec4 light_space_pos;
 out vec4 norm;
 out vec4 frag_pos;
+// tile of the block texture atlas, 0 bottom, 1 side, 2 top
+flat out int atlas_tile;
+// texture array layer of the block, only read when the blocks of every BlockId are drawn together
+flat out int texture_layer;
 
 uniform mat4 view;
+// world to view space normal matrix, instance normal matrices only carry the model transform
+uniform mat3 view_normal_mat;
+// packed instances only fill the first column of a_instancing_model with the block's cell
+uniform bool packed_instancing;
 uniform mat4 light_view;
 uniform mat4 projection;
 uniform mat4 light_projection;
 
 void main()
 {
-	gl_Position = projection * view * a_instancing_model * vec4(a_pos, 1.0f);
-	light_space_pos = light_projection * light_view * a_instancing_model * vec4(a_pos, 1.0f);
+	mat4 model = a_instancing_model;
+	mat3 normal_matrix = a_instancing_normal_matrix;
+	if (packed_instancing) {
+		// blocks are centered in their cell and never rotate or scale
+		model = mat4(1.0);
+		model[3] = vec4(a_instancing_model[0].xyz + 0.5, 1.0);
+		normal_matrix = mat3(1.0);
+	}
+
+	gl_Position = projection * view * model * vec4(a_pos, 1.0f);
+	light_space_pos = light_projection * light_view * model * vec4(a_pos, 1.0f);
 	// perspective division
 	light_space_pos = light_space_pos /  light_space_pos.w;
 	// transform from [-1, 1] to [0, 1]
 	light_space_pos = light_space_pos * 0.5 + 0.5;
 	tex_coord = a_tex_coord;
-	norm = vec4(normalize(a_instancing_normal_matrix * a_norm), 0.0);
-	frag_pos = view * a_instancing_model * vec4(a_pos, 1.0);
+	atlas_tile = (a_norm.y > 0.5) ? 2 : ((a_norm.y < -0.5) ? 0 : 1);
+	// indirect draws issue one command per BlockId in order
+	texture_layer = gl_DrawID;
+	norm = vec4(normalize(view_normal_mat * normal_matrix * a_norm), 0.0);
+	frag_pos = view * model * vec4(a_pos, 1.0);
 }
\ No newline at end of file
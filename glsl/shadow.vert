@@ -4,9 +4,16 @@ layout (location = 3) in mat4 a_instanced_model;
 
 uniform mat4 view;
 uniform mat4 projection;
+// packed instances only fill the first column of a_instanced_model with the block's cell
+uniform bool packed_instancing;
 
 void main()
 {
+	mat4 model = a_instanced_model;
+	if (packed_instancing) {
+		model = mat4(1.0);
+		model[3] = vec4(a_instanced_model[0].xyz + 0.5, 1.0);
+	}
 
-	gl_Position = projection * view * a_instanced_model * vec4(a_pos, 1.0f);
+	gl_Position = projection * view * model * vec4(a_pos, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "component.h"
+
+#include "glm/vec3.hpp"
+#include "glm/ext/vector_int3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// grid coordinate of a chunk in the x/z plane
+struct ChunkCoord
+{
+	// chunk containing a world position
+	static ChunkCoord fromPosition(const glm::vec3& position);
+	// world position of the chunk's minimum x/z corner, y is zero
+	glm::vec3 origin() const;
+	// squared distance in chunks, used for view radius checks
+	int distanceSquared(const ChunkCoord& other) const;
+	bool operator==(const ChunkCoord& other) const = default;
+
+	// square length of a chunk in blocks
+	static constexpr int size = 16;
+	// data
+	int x = 0;
+	int z = 0;
+};
+
+// dense voxel storage for a single chunk, each cell holds an index into a small palette of block ids
+class Chunk
+{
+public:
+	Chunk() noexcept;
+
+	// block at a chunk local cell, BlockId::Name::None is air
+	BlockId get(const glm::ivec3& local) const;
+	// set block at a chunk local cell, fails if the palette is full
+	bool set(const glm::ivec3& local, const BlockId id);
+	// true if the cell holds a block
+	bool isSolid(const glm::ivec3& local) const;
+	// number of non air cells
+	size_t numBlocks() const;
+	// lowest and highest cell height holding a block, lowest is above highest while the chunk is empty
+	int lowestBlock() const;
+	int highestBlock() const;
+	// bytes of memory the chunk holds, including its own size
+	size_t memoryUsage() const;
+	// call func(local, id) for every non air cell
+	template <typename Func>
+	void forEachBlock(Func&& func) const;
+	// compact encoding for region files, the palette then runs of palette indices in storage order
+	void encode(std::vector<uint8_t>& out) const;
+	// replace this chunk with an encoded one, false if the bytes are malformed
+	bool decode(const uint8_t* data, const size_t size);
+
+	// true if the local cell lies inside a chunk
+	static bool contains(const glm::ivec3& local);
+	// cells are stored column by column so a column of blocks is contiguous
+	static size_t index(const glm::ivec3& local);
+
+	// square length of a chunk in blocks
+	static constexpr int size = ChunkCoord::size;
+	// number of cells in a column
+	static constexpr int height = 64;
+	static constexpr size_t volume = size * size * height;
+	// palette index of air
+	static constexpr uint8_t air = 0;
+private:
+	// rescan every cell for the lowest and highest block, only needed when a block at either end is removed
+	void findBlockHeights();
+
+	// palette of block ids, index 0 is always air
+	std::vector<BlockId> palette;
+	// palette index per cell
+	std::vector<uint8_t> cells;
+	// cached number of non air cells
+	size_t num_blocks = 0;
+	// cached heights of the lowest and highest block, kept by set and decode
+	int lowest_block = height;
+	int highest_block = -1;
+};
+
+template <typename Func>
+void Chunk::forEachBlock(Func&& func) const
+{
+	for (int x = 0; x < size; x++) {
+		for (int z = 0; z < size; z++) {
+			for (int y = 0; y < height; y++) {
+				const glm::ivec3 local(x, y, z);
+				const uint8_t palette_index = cells[index(local)];
+				if (palette_index != air) {
+					func(local, palette[palette_index]);
+				}
+			}
+		}
+	}
+}
+
+template <>
+struct std::hash<ChunkCoord>
+{
+	size_t operator()(const ChunkCoord& coord) const noexcept;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+#include "chunk.h"
+#include "chunk_mesher.h"
+#include "chunk_mesh.h"
+
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// keeps chunks that streamed out in memory, so walking back into an area doesn't read, generate or mesh them again
+// voxel data, cpu mesh data and gpu meshes each have their own byte budget, a tier over budget evicts its least
+// recently used entries
+// voxel data is only cached once it is on disk or regenerates from the seed, so evicting it never loses an edit
+class ChunkCache
+{
+public:
+	// what a mesh was built from besides its own chunk, a cached mesh is only reused if this still matches
+	struct MeshKey {
+		int lod = 0;
+		// bit per neighbour the chunk was meshed against, in ChunkMesher::Neighbours order
+		uint8_t neighbours = 0;
+		bool operator==(const MeshKey& other) const = default;
+	};
+	struct Budgets {
+		size_t voxel_bytes = size_t(64) << 20;
+		size_t mesh_data_bytes = size_t(64) << 20;
+		size_t gpu_bytes = size_t(128) << 20;
+	};
+	// counters since the cache was created
+	struct TierStats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+		size_t bytes = 0;
+		size_t entries = 0;
+	};
+	struct Stats {
+		TierStats voxels;
+		TierStats mesh_data;
+		TierStats gpu_meshes;
+	};
+
+	ChunkCache() noexcept;
+	explicit ChunkCache(const Budgets& budgets) noexcept;
+
+	// cache the voxel data of an unloaded chunk
+	void putChunk(const ChunkCoord& coord, std::shared_ptr<Chunk> chunk);
+	// remove and return the voxel data of a chunk, null on a miss
+	std::shared_ptr<Chunk> takeChunk(const ChunkCoord& coord);
+	// keep the mesh data of a chunk, loaded or not, so it can be uploaded again without meshing
+	void putMeshData(const ChunkCoord& coord, const MeshKey& key, ChunkMesher::MeshData&& data);
+	// mesh data built with key, null on a miss, stays cached
+	const ChunkMesher::MeshData* findMeshData(const ChunkCoord& coord, const MeshKey& key);
+	// cache the gpu buffers of an unloaded chunk
+	void putMesh(const ChunkCoord& coord, const MeshKey& key, ChunkMesh&& mesh);
+	// remove the gpu buffers of a chunk into mesh if they were built with key
+	bool takeMesh(const ChunkCoord& coord, const MeshKey& key, ChunkMesh& mesh);
+	// drop every cached mesh of a chunk, its blocks or a border it was meshed against changed
+	void invalidateMeshes(const ChunkCoord& coord);
+	// drop every cached mesh, they were built in another meshing mode
+	void clearMeshes();
+	void clear();
+
+	// shrinking a budget evicts right away
+	void setBudgets(const Budgets& new_budgets);
+	const Budgets& getBudgets() const;
+	const Stats& getStats() const;
+
+private:
+	// one lru list per kind of data, most recently used first
+	template <typename Value>
+	class Tier
+	{
+	public:
+		struct Entry {
+			ChunkCoord coord;
+			MeshKey key;
+			Value value;
+			size_t bytes = 0;
+		};
+
+		// replace the entry of coord and evict down to budget
+		void put(const ChunkCoord& coord, const MeshKey& key, Value&& value, const size_t bytes, const size_t budget, TierStats& stats)
+		{
+			erase(coord, stats);
+			entries.push_front(Entry{coord, key, std::move(value), bytes});
+			index.insert_or_assign(coord, entries.begin());
+			stats.bytes += bytes;
+			stats.entries++;
+			evict(budget, stats);
+		}
+		// entry of coord built with key, null on a miss, a hit becomes the most recently used
+		Entry* find(const ChunkCoord& coord, const MeshKey& key, TierStats& stats)
+		{
+			const auto it = index.find(coord);
+			if ((it == index.end()) || !(it->second->key == key)) {
+				stats.misses++;
+				return nullptr;
+			}
+			stats.hits++;
+			entries.splice(entries.begin(), entries, it->second);
+			return &*it->second;
+		}
+		void erase(const ChunkCoord& coord, TierStats& stats)
+		{
+			const auto it = index.find(coord);
+			if (it == index.end()) return;
+
+			stats.bytes -= it->second->bytes;
+			stats.entries--;
+			entries.erase(it->second);
+			index.erase(it);
+		}
+		void evict(const size_t budget, TierStats& stats)
+		{
+			while (!entries.empty() && (stats.bytes > budget)) {
+				stats.evictions++;
+				erase(entries.back().coord, stats);
+			}
+		}
+		void clear(TierStats& stats)
+		{
+			entries.clear();
+			index.clear();
+			stats.bytes = 0;
+			stats.entries = 0;
+		}
+
+	private:
+		std::list<Entry> entries;
+		std::unordered_map<ChunkCoord, typename std::list<Entry>::iterator> index;
+	};
+
+	// bytes held by mesh data
+	static size_t meshDataBytes(const ChunkMesher::MeshData& data);
+
+	Budgets budgets;
+	Stats stats{};
+	Tier<std::shared_ptr<Chunk>> voxels;
+	Tier<ChunkMesher::MeshData> mesh_data;
+	Tier<ChunkMesh> gpu_meshes;
+};
+
+#endif
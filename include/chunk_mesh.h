@@ -0,0 +1,62 @@
+#ifndef CHUNK_MESH_H
+#define CHUNK_MESH_H
+
+#include "chunk_mesher.h"
+#include "component.h"
+#include "instance.h"
+
+#include "glad/gl.h"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+#include <cstddef>
+
+// opengl buffers for the geometry of one chunk
+class ChunkMesh
+{
+public:
+	ChunkMesh() noexcept = default;
+	// upload mesh data, position is the world center of the chunk's first cell which chunk local space is relative to
+	ChunkMesh(const ChunkMesher::MeshData& data, const glm::vec3& position) noexcept;
+	~ChunkMesh();
+	ChunkMesh(const ChunkMesh& other) = delete;
+	ChunkMesh(ChunkMesh&& other) noexcept;
+	ChunkMesh& operator=(const ChunkMesh& other) = delete;
+	ChunkMesh& operator=(ChunkMesh&& other) noexcept;
+
+	// draw every face belonging to a block id, textures must already be bound
+	void draw(const BlockId id) const;
+	// size of the uploaded geometry
+	size_t numVertices() const;
+	size_t numIndices() const;
+	// bytes of the gpu buffers
+	size_t gpuBytes() const;
+	// solid height of each chunk quarter, see ChunkMesher::MeshData
+	const std::array<int, 4>& occluderHeights() const;
+	// chunk local heights the geometry spans, see ChunkMesher::MeshData
+	int bottom() const;
+	int top() const;
+
+private:
+	// a chunk is drawn as a single instance so the block shaders can be reused
+	void setupMesh(const ChunkMesher::MeshData& data, const glm::vec3& position);
+	void free();
+
+	GLuint VAO{0};
+	GLuint VBO{0};
+	GLuint EBO{0};
+	GLuint instance_buffer{0};
+	std::array<ChunkMesher::IndexRange, BlockId::NumNames> ranges{};
+	size_t num_vertices{0};
+	size_t num_indices{0};
+	std::array<int, 4> occluder_heights{};
+	int bottom_height{0};
+	int top_height{0};
+	// vertex attribute index of the instance data, matches Mesh
+	static const GLuint instance_vertex_attrib_index = 3;
+	// size of the chunk's single instance, a packed chunk uploads its cell as a float vec4
+	static constexpr size_t origin_bytes = PACKED_INSTANCES ? sizeof(glm::vec4) : sizeof(Instance);
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef CHUNK_MESHER_H
+#define CHUNK_MESHER_H
+
+#include "mesh.h"
+#include "chunk.h"
+#include "component.h"
+
+#include "glm/ext/vector_int3.hpp"
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// builds renderable geometry for a chunk, only faces that border air are emitted
+class ChunkMesher
+{
+public:
+	enum class Mode {
+		// one quad per visible block face
+		Culled,
+		// coplanar visible faces of the same block id are merged into larger quads
+		Greedy
+	};
+
+	// span of the index buffer used by one block id
+	struct IndexRange {
+		size_t first = 0;
+		size_t count = 0;
+	};
+
+	// geometry of a chunk in chunk local space, cell (0, 0, 0) is centered on the origin
+	// texture coordinates count blocks, the shader wraps them into the right tile of the block atlas
+	struct MeshData {
+		std::vector<Mesh::Vertex> vertices;
+		// indices are grouped by block id so each id can be drawn with its own textures
+		std::vector<unsigned int> indices;
+		std::array<IndexRange, BlockId::NumNames> ranges{};
+		// cells of unbroken solid ground under every column of each chunk quarter, -x-z, +x-z, -x+z, +x+z order
+		std::array<int, 4> occluder_heights{};
+		// chunk local heights the geometry spans, from the bottom of the lowest cell to the top of the highest
+		int bottom = 0;
+		int top = 0;
+	};
+
+	// adjacent chunks in +x, -x, +z, -z order, null if the chunk isn't loaded
+	using Neighbours = std::array<const Chunk*, 4>;
+
+	// mesh a chunk, faces against unloaded neighbours are kept so the edge of the world stays closed
+	// level of detail n merges 2^n blocks into one cell along each axis, only pass neighbours meshed at the same level,
+	// the walls left at the other borders hang down as skirts that cover the seam between levels
+	static MeshData mesh(const Chunk& chunk, const Neighbours& neighbours, const Mode mode = Mode::Greedy, const int lod = 0);
+
+	// number of levels of detail, the coarsest cells must still divide a chunk evenly
+	static constexpr int num_lods = 3;
+	static_assert(((Chunk::size >> (num_lods - 1)) << (num_lods - 1)) == Chunk::size);
+	static_assert(((Chunk::height >> (num_lods - 1)) << (num_lods - 1)) == Chunk::height);
+
+private:
+	// block ids of a chunk at some level of detail plus a one cell border taken from its neighbours
+	class Volume
+	{
+	public:
+		Volume(const Chunk& chunk, const Neighbours& neighbours, const int lod);
+		// number of cells inside the chunk along each axis
+		const glm::ivec3& dims() const;
+		// blocks along each axis of a cell
+		int scale() const;
+		// local cells may be one outside of the chunk in every direction
+		BlockId get(const glm::ivec3& local) const;
+		bool isSolid(const glm::ivec3& local) const;
+	private:
+		size_t index(const glm::ivec3& local) const;
+		// a cell is solid if at least half its blocks are, it takes the id of the highest block up to one cell
+		// above it so surfaces that round away still show their material on the cell below
+		static uint8_t sample(const Chunk& chunk, const glm::ivec3& cell, const int scale);
+		glm::ivec3 size;
+		int cell_scale;
+		// zero is air, otherwise block id + 1
+		std::vector<uint8_t> cells;
+	};
+
+	// cube face in chunk local space
+	struct Face {
+		glm::ivec3 normal;
+		// corners relative to the cell center, counter clockwise when viewed from outside
+		std::array<glm::vec3, 4> corners;
+		// directions texture coordinates increase along, oriented like the block model
+		glm::vec3 u_axis;
+		glm::vec3 v_axis;
+	};
+	// visible faces of one block id, grouped for packing
+	struct Geometry {
+		std::array<std::vector<Mesh::Vertex>, BlockId::NumNames> vertices;
+		std::array<std::vector<unsigned int>, BlockId::NumNames> indices;
+	};
+
+	// emit a quad covering the cells from min_cell to max_cell inclusive, cells are scale blocks wide
+	static void addQuad(Geometry& geometry, const BlockId id, const Face& face, const glm::ivec3& min_cell, const glm::ivec3& max_cell, const int scale);
+	// one quad per visible face
+	static void meshCulled(Geometry& geometry, const Volume& volume);
+	// sweep each face direction slice by slice, merging runs of identical visible faces into rectangles
+	static void meshGreedy(Geometry& geometry, const Volume& volume);
+
+	// solid height of each chunk quarter, boxes that size are safe to use as occluders
+	static std::array<int, 4> occluderHeights(const Chunk& chunk);
+
+	// the six faces of a block model
+	static const std::array<Face, 6> faces;
+};
+
+#endif
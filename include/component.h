@@ -8,10 +8,6 @@ struct Position
 	Position() noexcept = default;
 	Position(const Position& position) noexcept = default;
 	Position(float x, float y, float z) noexcept;
-	// serialize
-	template <typename Archive>
-	void serialize(Archive &archive);
-
 	// data
 	glm::vec3 vec3;
 };
@@ -29,9 +25,6 @@ struct BlockId
 	BlockId(const unsigned int name) noexcept;
 	BlockId(const Name name) noexcept;
 	BlockId(const BlockId&) noexcept = default;
-	// serialization
-	template <typename Archive>
-	void serialize(Archive &archive);
 	// conversions
 	unsigned int uint() const;
 	operator Name() const;
@@ -48,9 +41,6 @@ struct BoxCollider
 {
 	BoxCollider() noexcept = default;
 	BoxCollider(const BoxCollider&) noexcept = default;
-	// serialization
-	template <typename Archive>
-	void serialize(Archive &archive);
 
 	// data
 	glm::vec3 offset = { 0.0f, 0.0f, 0.0f };
@@ -0,0 +1,134 @@
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include "component.h"
+
+#include "glm/vec3.hpp"
+#include "glm/ext/vector_int3.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+// append only log of the world edits made since the last finished save, replayed on startup so a crash keeps them
+// every save rotates the journal into a numbered file, the save records the last generation it covers and
+// rotated files are deleted once it is on disk, so a journal is never replayed over a save that already holds it
+// records carry a checksum, a torn record at the end of a file ends the replay of that file
+// commits are written and synced on a worker thread, so edits never wait on the disk
+class EditJournal
+{
+public:
+	struct Edit {
+		enum class Type : uint8_t {
+			SetBlock,
+			PlaceEntity,
+			DestroyEntity
+		};
+
+		Type type = Type::SetBlock;
+		BlockId id;
+		// world cell of a terrain edit
+		glm::ivec3 cell{};
+		// position of a placed or destroyed block entity
+		glm::vec3 pos{};
+	};
+	// what a rotation did with the current file
+	enum class Rotation {
+		// the journal held no edits, nothing moved
+		Empty,
+		Rotated,
+		// the edits couldn't be written or moved aside and are still in the current generation
+		Failed
+	};
+
+	explicit EditJournal(const std::string& path);
+	// writes buffered and committed edits before closing
+	~EditJournal();
+	EditJournal(const EditJournal& other) = delete;
+	EditJournal(EditJournal&& other) = delete;
+	EditJournal& operator=(const EditJournal& other) = delete;
+	EditJournal& operator=(EditJournal&& other) = delete;
+
+	// read the edits a previous run left after its last save in the order they were made, then start a new journal
+	// journals of another seed or covered by saved_generation are deleted
+	bool open(const uint32_t seed, const uint32_t saved_generation, std::vector<Edit>& edits);
+	// delete every journal file and start an empty journal for a new world
+	bool reset(const uint32_t seed);
+	// buffer an edit, it only reaches the disk on the next commit
+	void append(const Edit& edit);
+	// hand buffered edits to the worker, one sync covers every edit since the last commit
+	// edits of a failed write are kept and written again with the next commit
+	void commit();
+	// write every buffered edit and move the journal aside before a save
+	// a save taken after a failed rotation must not be written, the current generation it would cover is still appended to
+	Rotation rotate();
+	// delete rotated journals, only once every save queued after rotating them is on disk
+	void dropRotated();
+	bool hasRotated() const;
+	bool hasPending() const;
+	// bytes in the current journal file
+	size_t size() const;
+	// every edit of this generation and older is in a save taken now
+	uint32_t coveredGeneration() const;
+
+private:
+	struct Header {
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t seed = 0;
+		uint32_t generation = 0;
+	};
+
+	// worker loop, writes committed edits until stopping
+	void run();
+	// append encoded edits to the current file and sync it, call with the worker idle
+	bool writeRecords(const std::vector<uint8_t>& bytes);
+	// truncate the current file and write its header
+	bool startFile();
+	// path of a rotated journal
+	std::string rotatedPath(const uint32_t generation) const;
+	// the current journal and every rotated one found beside it, a crash may leave several behind
+	std::vector<std::string> journalPaths() const;
+	// read a journal's header and the records up to the first torn or corrupt one, false if it isn't a journal
+	static bool readJournal(const std::string& path, Header& header, std::vector<Edit>& edits);
+	static void encode(const Edit& edit, std::vector<uint8_t>& out);
+	static Edit decode(const uint8_t* payload);
+
+	// "OGPJ" in a little endian file
+	static constexpr uint32_t magic = 0x4A50474F;
+	// bump when the record layout changes, old journals are ignored
+	static constexpr uint32_t version = 1;
+	// type, id and three coordinates
+	static constexpr size_t payload_size = 1 + (4 * sizeof(uint32_t));
+	// payload size and crc in front of every payload
+	static constexpr size_t record_size = (2 * sizeof(uint32_t)) + payload_size;
+
+	std::string path;
+	// only used by whoever writes, the worker or the main thread while the worker is idle
+	std::ofstream stream;
+	// encoded edits waiting for the next commit, main thread only
+	std::vector<uint8_t> pending;
+	// generations moved aside since the last drop, oldest first
+	std::vector<uint32_t> rotated_generations;
+	// bytes of the current file that are written and synced, a failed write is cut back to it
+	size_t file_size = 0;
+	uint32_t seed = 0;
+	// generation of the current file
+	uint32_t generation = 1;
+	// guards everything below and file_size
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	// committed edits the worker hasn't written yet
+	std::vector<uint8_t> committed;
+	bool writing = false;
+	bool stopping = false;
+	// started last so every member above exists before the worker reads it
+	std::thread worker;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+
+// view volume of a projection * view matrix as six inward facing planes
+class Frustum
+{
+public:
+	Frustum() noexcept = default;
+	explicit Frustum(const glm::mat4& view_projection) noexcept;
+
+	// true if any part of the axis aligned box may be visible
+	bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+	const std::array<glm::vec4, 6>& getPlanes() const;
+
+private:
+	// xyz is the plane normal, w the distance, points inside have dot(xyz, point) + w >= 0
+	std::array<glm::vec4, 6> planes{};
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include "shader.h"
+#include "frustum.h"
+#include "instance.h"
+#include "instance_buffer.h"
+#include "component.h"
+#include "mesh.h"
+
+#include "glad/gl.h"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstddef>
+
+// frustum culls instances in a compute shader and draws the survivors indirectly, the cpu never visits single instances
+// every block model shares one vertex array and one texture array layer per BlockId, so a pass is a single multi-draw
+class GpuCuller
+{
+public:
+	// layout glMultiDrawElementsIndirect reads, one per BlockId
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	// throws if the compute shader fails to compile
+	GpuCuller();
+	~GpuCuller();
+	GpuCuller(const GpuCuller& other) = delete;
+	GpuCuller(GpuCuller&& other) = delete;
+	GpuCuller& operator=(const GpuCuller& other) = delete;
+	GpuCuller& operator=(GpuCuller&& other) = delete;
+
+	// set the geometry and textures a BlockId's instances are drawn with, replaces what it had before
+	void setBlockMesh(const BlockId id, const std::vector<Mesh::Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Mesh::Texture>& textures);
+	// make room for count culled instances per BlockId
+	void reserve(const size_t count);
+	// cull every BlockId's instances, the draw commands are ready once this returns
+	void cull(const Frustum& frustum, const std::vector<InstanceBuffer>& buffers, const std::vector<std::vector<Instance>>& instances) const;
+	// draw every BlockId's culled instances with one multi-draw
+	void draw(const Shader& shader) const;
+
+	inline static const std::string cull_shader_path{"./glsl/cull.comp"};
+	// must match local_size_x in the compute shader
+	static const GLuint work_group_size = 64;
+	// must match the instance attribute location in the vertex shaders
+	static const GLuint instance_vertex_attrib_index = 3;
+	// units the block texture arrays are bound to, clear of the material textures and the depth map
+	static const GLuint diffuse_texture_unit = 14;
+	static const GLuint specular_texture_unit = 15;
+
+private:
+	Shader shader;
+	// culled instances of every BlockId, capacity instances each
+	GLuint culled_buffer{0};
+	GLuint command_buffer{0};
+	size_t capacity{0};
+	// geometry of every block model, one after another
+	GLuint VAO{0};
+	GLuint VBO{0};
+	GLuint EBO{0};
+	std::array<std::vector<Mesh::Vertex>, BlockId::NumNames> block_vertices;
+	std::array<std::vector<unsigned int>, BlockId::NumNames> block_indices;
+	// where each BlockId's geometry starts in the shared buffers
+	std::array<GLuint, BlockId::NumNames> first_indices{};
+	std::array<GLint, BlockId::NumNames> base_vertices{};
+	// textures of each BlockId and the arrays they are copied into, layer i belongs to BlockId i
+	std::array<GLuint, BlockId::NumNames> diffuse_textures{};
+	std::array<GLuint, BlockId::NumNames> specular_textures{};
+	GLuint diffuse_array{0};
+	GLuint specular_array{0};
+
+	// rebuild the shared vertex and index buffers
+	void uploadGeometry();
+	// rebuild a texture array from the first level of every BlockId's texture, textures must share a size
+	static void buildTextureArray(GLuint& array, const std::array<GLuint, BlockId::NumNames>& textures);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "glad/gl.h"
+#include "glm/mat4x4.hpp"
+#include "glm/mat3x3.hpp"
+#include "glm/vec3.hpp"
+
+#include <type_traits>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// blocks are axis aligned and unit sized so an instance only needs its cell, false for instances with arbitrary transforms
+// the OPENGL_PRACTICE_PACKED_INSTANCES cmake option turns it off
+#ifndef PACKED_INSTANCES
+#define PACKED_INSTANCES true
+#endif
+
+// 8 byte instance, the block shaders read it as the first column of the instance model matrix
+struct PackedInstance
+{
+	// instance of a block centered at position, cells past the int16 range are clamped to its edge
+	static PackedInstance fromPosition(const glm::vec3& position);
+	// position lies in a cell the packed layout can hold
+	static bool inRange(const glm::vec3& position);
+	// bulk fromPosition, out must hold count instances
+	static void fromPositions(const glm::vec3* positions, PackedInstance* out, const size_t count);
+	// describe the instance layout to the bound vertex array and array buffer
+	static void setupAttribs(const GLuint vertex_attrib_index);
+	// center of the block
+	glm::vec3 position() const;
+
+	// world cell of the block
+	int16_t x = 0;
+	int16_t y = 0;
+	int16_t z = 0;
+	// per block state bits
+	uint16_t flags = 0;
+
+	static constexpr float min_cell = std::numeric_limits<int16_t>::min();
+	static constexpr float max_cell = std::numeric_limits<int16_t>::max();
+};
+static_assert(sizeof(PackedInstance) == 8);
+
+// full transform for instances that rotate or scale
+struct MatrixInstance
+{
+	// instance of a block centered at position
+	static MatrixInstance fromPosition(const glm::vec3& position);
+	// any float position fits a matrix
+	static bool inRange(const glm::vec3& position);
+	// bulk fromPosition, out must hold count instances
+	static void fromPositions(const glm::vec3* positions, MatrixInstance* out, const size_t count);
+	// describe the instance layout to the bound vertex array and array buffer
+	static void setupAttribs(const GLuint vertex_attrib_index);
+	// center of the block
+	glm::vec3 position() const;
+
+	glm::mat4 model{1.0f};
+	glm::mat3 normal_mat{1.0f};
+};
+
+using Instance = std::conditional_t<PACKED_INSTANCES, PackedInstance, MatrixInstance>;
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include "instance.h"
+
+#include "glad/gl.h"
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// opengl copy of a vector of instances, changes are recorded and uploaded together on flush
+class InstanceBuffer
+{
+public:
+	enum class Mode {
+		// mutable buffer updated with glNamedBufferSubData, reallocated when instances outgrow it
+		SubData,
+		// immutable persistently mapped buffer split into segments, each flush writes the next segment
+		// once the gpu is done reading it so uploads never stall the driver, only the ranges that segment
+		// missed since it was last written are copied
+		// outgrowing a segment still moves to a new buffer of twice the size, the old one is released once its
+		// pending draws finish, so sizing initial_ring_capacity for the expected instances keeps it from happening
+		PersistentRing
+	};
+
+	InstanceBuffer(const Mode mode = Mode::SubData) noexcept;
+	~InstanceBuffer();
+	InstanceBuffer(const InstanceBuffer& other) = delete;
+	InstanceBuffer(InstanceBuffer&& other) noexcept;
+	InstanceBuffer& operator=(const InstanceBuffer& other) = delete;
+	InstanceBuffer& operator=(InstanceBuffer&& other) noexcept;
+
+	GLuint getId() const;
+	Mode getMode() const;
+	// bind the buffer to a vertex array's instance attributes, kept up to date if the buffer is ever replaced
+	void attach(const GLuint VAO, const GLuint vertex_attrib_index) const;
+	// instances in [first, last) changed since the last flush
+	void markDirty(const size_t first, const size_t last);
+	// every instance changed
+	void markAllDirty();
+	// upload the union of the dirty ranges in one copy, reallocate if instances outgrew the buffer, false if nothing changed
+	bool flush(const std::vector<Instance>& instances);
+	// the gpu is reading the current segment until every command issued so far completes
+	void fence();
+	// first instance of the current data, draws must start from here
+	size_t baseInstance() const;
+	// number of uploads issued since construction
+	size_t numUploads() const;
+	// number of times a ring flush had to wait for the gpu
+	size_t numStalls() const;
+
+	// segments in the ring, frames the gpu may lag behind before a flush has to wait
+	static const size_t ring_segments = 3;
+	// instances per ring segment before the first growth
+	static const size_t initial_ring_capacity = 1 << 14;
+
+private:
+	// instances [first, last), empty when first >= last
+	struct Range {
+		size_t first = 0;
+		size_t last = 0;
+	};
+
+	// grow range to cover [first, last)
+	static void mergeRange(Range& range, const size_t first, const size_t last);
+	// create the buffer with room for capacity instances, per segment in ring mode
+	void allocate(const size_t new_capacity);
+	// wait until the gpu is done reading a ring segment
+	void waitSegment(const size_t index);
+	void free();
+
+	Mode mode{Mode::SubData};
+	GLuint id{0};
+	// instances the buffer has room for, per segment in ring mode, tracked here so we never have to query the driver
+	size_t capacity{0};
+	// union of the ranges changed since the last flush
+	Range dirty{};
+	size_t num_uploads{0};
+	size_t num_stalls{0};
+	// ring mode
+	Instance* mapped{nullptr};
+	size_t segment{0};
+	std::vector<GLsync> fences;
+	// ranges each segment is missing, the union of every flush since it was last written
+	std::vector<Range> segment_ranges;
+	// vertex arrays and attribute indices reading this buffer
+	mutable std::vector<std::pair<GLuint, GLuint>> attachments;
+};
+
+#endif
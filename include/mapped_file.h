@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// read only view of a whole file mapped into memory, pages are only read from disk when they are first touched
+class MappedFile
+{
+public:
+	MappedFile() noexcept = default;
+	~MappedFile();
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(const MappedFile& other) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// map the file at path, replacing any earlier mapping, false if the file is missing or empty
+	bool open(const std::string& path);
+	// unmap the file
+	void close();
+	bool isOpen() const;
+	const uint8_t* data() const;
+	size_t size() const;
+
+private:
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+};
+
+#endif
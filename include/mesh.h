@@ -42,8 +42,10 @@ class Mesh {
         Mesh& operator=(const Mesh& other) = delete;
         Mesh& operator=(Mesh&& other) noexcept;
 
-        // draw number of instances indicated by num, zero draws without instancing
-        void draw(const Shader& shader, const unsigned int num = 0) const;
+        // draw number of instances indicated by num starting from base_instance, zero draws without instancing
+        void draw(const Shader& shader, const unsigned int num = 0, const unsigned int base_instance = 0) const;
+        // bind textures to the shader's material samplers
+        void bindTextures(const Shader& shader) const;
         // add a vertex attribute array of vec4s for instance rendering
         void setupInstancing(const World& world, const BlockId id) const;
 
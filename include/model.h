@@ -26,10 +26,12 @@ class Model
 	    Model& operator=(const Model& other) = delete;
 	    Model& operator=(Model&& other) = delete;
 
-        // draw number of instances indicated by num, zero draws without instancing
-        void draw(const Shader& shader, const unsigned int num = 0) const;
+        // draw number of instances indicated by num starting from base_instance, zero draws without instancing
+        void draw(const Shader& shader, const unsigned int num = 0, const unsigned int base_instance = 0) const;
         // add a vertex attribute array of vec4s for instance rendering
         void setupInstancing(const World& world) const;
+        // bind the model's textures so other geometry can be drawn with them
+        void bindTextures(const Shader& shader) const;
 
         const BlockId id;
 
@@ -0,0 +1,44 @@
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+#include <vector>
+
+// low resolution depth buffer rasterized on the cpu, boxes hidden behind nearby occluders can skip draw submission
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer(const int width = default_width, const int height = default_height) noexcept;
+
+	// clear to the far plane and project the following boxes with view_projection
+	void begin(const glm::mat4& view_projection);
+	// rasterize a solid box, boxes crossing the near plane are skipped
+	bool addOccluder(const glm::vec3& min, const glm::vec3& max);
+	// false only if every pixel the box covers is behind an occluder
+	bool isVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+	// width is kept a multiple of the simd lane count
+	static const int default_width = 256;
+	static const int default_height = 128;
+
+private:
+	// screen space corner, z is the depth compared against the buffer
+	using Corners = std::array<glm::vec3, 8>;
+
+	// project the corners of a box, false if any of them is in front of the near plane
+	bool project(const glm::vec3& min, const glm::vec3& max, Corners& corners) const;
+	// keep the nearest depth of every pixel whose center is inside the triangle
+	void rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+	int width;
+	int height;
+	glm::mat4 view_projection{1.0f};
+	// normalized device depth of the nearest occluder per pixel, rows top to bottom
+	std::vector<float> depth;
+};
+
+#endif
@@ -36,6 +36,4 @@
 
 #include "PerlinNoise.hpp"
 
-#include "cereal/archives/binary.hpp"
-
 #endif
\ No newline at end of file
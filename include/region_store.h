@@ -0,0 +1,97 @@
+#ifndef REGION_STORE_H
+#define REGION_STORE_H
+
+#include "chunk.h"
+#include "mapped_file.h"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// chunks saved in square regions of region_size x region_size chunks, one file per region
+// a region file is a header, an offset table with one entry per chunk, then the encoded chunk records in any order,
+// appends end with a copy of the new header and table, which is used if the one at the head is torn,
+// region files are memory mapped and records decode straight out of the mapping, so reading a chunk only
+// faults in the pages of its own record
+class RegionStore
+{
+public:
+	// chunks handed to a save, shared so the caller can keep editing its own copies while the save runs
+	using ChunkRefs = std::vector<std::pair<ChunkCoord, std::shared_ptr<const Chunk>>>;
+
+	explicit RegionStore(const std::string& directory) noexcept;
+
+	// every call is safe while a save runs on another thread, only one save may run at a time
+	// read the chunks at coords, found[i] is false if a chunk was never saved or its record is corrupt
+	void load(const std::vector<ChunkCoord>& coords, std::vector<Chunk>& chunks, std::vector<uint8_t>& found) const;
+	// write the given chunks, records of every other chunk are kept, bytes_written counts what reached the disk
+	// new records are appended and the offset table patched in place, so a save costs about as much as it changed
+	bool save(const ChunkRefs& chunks, size_t& bytes_written) const;
+	// delete every region file
+	void clear() const;
+	// unmap every region file, they are mapped again when next read
+	void close() const;
+
+	// region that holds a chunk
+	static ChunkCoord regionOf(const ChunkCoord& coord);
+
+	// square length of a region in chunks
+	static constexpr int region_size = 32;
+	// bump when the record or table layout changes, old files are ignored
+	static constexpr uint32_t version = 1;
+
+private:
+	struct Header {
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		// crc of the offset table
+		uint32_t table_crc = 0;
+		uint32_t num_records = 0;
+	};
+	// a record of size zero is a chunk that was never saved
+	struct Entry {
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		uint32_t crc = 0;
+	};
+	using Table = std::array<Entry, region_size * region_size>;
+	// a mapped region file, missing and corrupt files are kept too so they aren't opened again
+	struct Region {
+		MappedFile file;
+		Table table{};
+		bool valid = false;
+	};
+
+	// path of a region's file
+	std::string regionPath(const ChunkCoord& region) const;
+	// map a region file on first use and verify its header and offset table
+	const Region& openRegion(const ChunkCoord& region) const;
+	// append records to an existing region and patch its offset table, false if the region needs a rewrite
+	// because it is missing, corrupt or mostly garbage from replaced records
+	bool appendRegion(const ChunkCoord& region, const std::vector<std::vector<uint8_t>>& records,
+		const std::vector<uint8_t>& present, const size_t new_bytes, size_t& bytes_written) const;
+	// write a compacted region file from the given records and the live records of the old file
+	bool rewriteRegion(const ChunkCoord& region, std::vector<std::vector<uint8_t>>& records,
+		std::vector<uint8_t>& present, size_t& bytes_written) const;
+	// point data at a record inside the mapping, false if it is missing, out of bounds or fails its checksum
+	static bool findRecord(const Region& region, const Entry& entry, const uint8_t*& data);
+	// index of a chunk in its region's offset table
+	static size_t entryIndex(const ChunkCoord& coord);
+
+	// "OGPR" in a little endian file
+	static constexpr uint32_t magic = 0x5250474F;
+
+	std::string directory;
+	// regions mapped so far, saving a region drops its mapping before the file is replaced
+	mutable std::unordered_map<ChunkCoord, Region> regions;
+	// guards regions, held while records are read out of a mapping
+	mutable std::mutex mutex;
+};
+
+#endif
@@ -3,7 +3,7 @@
 
 class GLFWwindow;
 class Camera;
-class LightBlock;
+class World;
 #include "utils.h"
 
 #include "glfw.h"
@@ -15,7 +15,7 @@ class ScreenManager
 {
 public:
 	ScreenManager(const std::shared_ptr<Camera>& camera);
-	~ScreenManager() = default;
+	~ScreenManager();
 	ScreenManager(const ScreenManager& other) = delete;
 	ScreenManager(ScreenManager&& other) noexcept;
 	ScreenManager& operator=(const ScreenManager& other) = delete;
@@ -25,6 +25,8 @@ public:
 	GLFWwindow* const getWindow();
 	// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 	void processInput(const float delta_time);
+	// draw the debug window over the finished frame, call before endFrame
+	void drawDebugWindow(World& world);
 	// buffer swap and input poll
 	void endFrame();
 	double getTime();
@@ -46,7 +48,7 @@ private:
 	void processMouseInput(const float delta_time);
 	void processGamepadInput(const float delta_time);
 	// imgui management
-	void imguiStartFrame(LightBlock& light_block, bool* p_open = NULL);
+	void imguiStartFrame(World& world, bool* p_open = NULL);
 	void imguiEndFrame();
 	void imguiInit(GLFWwindow* window);
 	void imguiShutdown();
@@ -59,6 +61,8 @@ private:
 	GLFWwindow* window;
 	// call glfwTerminate even if we fail to construct
 	utils::ScopedDeleter glfw_deleter{&glfwTerminate};
+	// moved from managers leave imgui to the new owner
+	bool imgui_initialized = false;
 	// TODO add input_manager so screen_manager isn't dependent on camera
 	std::shared_ptr<Camera> camera;
 };
@@ -17,12 +17,15 @@ public:
 		Linker,
 		Vertex,
 		Fragment,
-		Geometry
+		Geometry,
+		Compute
 	};
 
 	Shader() noexcept;
 	Shader(std::string&& vertex_path, std::string&& fragment_path, std::string&& geometry_path={});
 	Shader(const std::string& vertex_path, const std::string& fragment_path, const std::string& geometry_path={});
+	// compute only program
+	explicit Shader(const std::string& compute_path);
 	~Shader();
 	Shader(const Shader& other) = delete;
 	Shader(Shader&& other) noexcept;
@@ -38,7 +41,7 @@ public:
 	// delete program, delete shader type
 	void resetShaderCode(const ProgramType type);
 	bool addLights(const ProgramType type, std::shared_ptr<LightBlock> light_block_in={});
-	// compile, attach, and link all shader programs
+	// compile, attach, and link all shader programs, a compute program can't be combined with the other stages
 	bool compile();
 
 	// utility uniform functions
@@ -78,6 +81,7 @@ private:
 	unsigned int vertex_num_injected{0};
 	unsigned int fragment_num_injected{0};
 	unsigned int geometry_num_injected{0};
+	unsigned int compute_num_injected{0};
 	// light data
 	std::shared_ptr<LightBlock> light_block;
 	std::unordered_set<ProgramType> lit_programs{};
@@ -85,8 +89,10 @@ private:
 	std::string vertex_code{};
 	std::string fragment_code{};
 	std::string geometry_code{};
+	std::string compute_code{};
 	std::string vertex_path{};
 	std::string fragment_path{};
 	std::string geometry_path{};
+	std::string compute_path{};
 };
 #endif
\ No newline at end of file
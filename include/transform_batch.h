@@ -0,0 +1,19 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include "glm/mat4x4.hpp"
+#include "glm/mat3x3.hpp"
+
+#include <cstddef>
+
+// bulk matrix math for instance data, runs on SIMD lanes and every hardware thread
+namespace transform_batch
+{
+	// inverse transpose of the upper 3x3 of each affine model matrix, normal_mats must hold count matrices
+	void normalMatrices(const glm::mat4* models, glm::mat3* normal_mats, const size_t count);
+
+	// instances handled per job, smaller batches aren't worth waking other threads for
+	inline constexpr size_t parallel_grain = 4096;
+}
+
+#endif
@@ -7,6 +7,9 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
 
 #define STRINGIFY_MACRO_EXPANSION(x) #x
 #define STRINGIFY(x) STRINGIFY_MACRO_EXPANSION(x)
@@ -53,6 +56,24 @@ namespace utils
 	// read the file at path and output it to out
 	bool readFile(const std::string& path, std::string& out);
 
+	// call func for every index in [0, count) on the calling thread and a persistent pool with a worker per other
+	// hardware thread, a call made while the pool is busy runs on the calling thread alone
+	void parallelFor(const size_t count, const std::function<void(size_t)>& func);
+
+	// crc-32 of a byte range, pass a previous result as crc to continue a running checksum
+	uint32_t crc32(const void* data, const size_t size, const uint32_t crc = 0);
+
+	// append value as a little endian base 128 varint
+	void writeVarint(std::vector<uint8_t>& out, uint64_t value);
+	// read a varint at pos and move pos past it, false if the bytes run out first
+	bool readVarint(const uint8_t*& pos, const uint8_t* end, uint64_t& value);
+
+	// block until every write to the file at path has reached the disk
+	bool syncFile(const std::string& path);
+	// block until files renamed into or created in the directory at path survive a power loss, empty is the working directory
+	// windows commits the rename with the file, so this does nothing there
+	bool syncDirectory(const std::string& path);
+
 	// custom free operator for shared pointers
 	struct FreeDelete
 	{
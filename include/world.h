@@ -1,23 +1,82 @@
 #ifndef WORLD_H
 #define WORLD_H
 
-struct BlockId;
+#include "component.h"
+#include "chunk.h"
+#include "chunk_mesher.h"
+#include "chunk_mesh.h"
+#include "instance.h"
+#include "instance_buffer.h"
+#include "frustum.h"
+#include "gpu_culler.h"
+#include "occlusion_buffer.h"
+#include "region_store.h"
+#include "world_saver.h"
+#include "edit_journal.h"
+#include "chunk_cache.h"
+#include "mesh.h"
 
 #include "glm/mat4x4.hpp"
 #include "glm/mat3x3.hpp"
+#include "glm/vec3.hpp"
+#include "glm/ext/vector_int3.hpp"
 #include "glad/gl.h"
 #include "entt/entity/registry.hpp"
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
+#include <limits>
+#include <memory>
+#include <cstdint>
+#include <chrono>
+#include <utility>
 
 class World
 {
 public:
 	using Registry = entt::basic_registry<uint64_t>;
 	using Entity = Registry::entity_type;
+	enum class CullingMode {
+		// instance buckets are tested on the cpu and drawn with instanced draws
+		Cpu,
+		// instances are tested in a compute shader and drawn with indirect draws
+		Gpu
+	};
 
-	World() noexcept;
+	// queues world edits and applies them together, instance data is patched in bulk instead of once per entity signal
+	// pending edits are committed when the transaction is destroyed
+	class EditTransaction
+	{
+	public:
+		explicit EditTransaction(World& world) noexcept;
+		~EditTransaction();
+		EditTransaction(const EditTransaction& other) = delete;
+		EditTransaction(EditTransaction&& other) = delete;
+		EditTransaction& operator=(const EditTransaction& other) = delete;
+		EditTransaction& operator=(EditTransaction&& other) = delete;
+
+		// create an instanced block entity at pos, ignored if the instance layout can't hold pos
+		void placeEntity(const BlockId id, const glm::vec3& pos);
+		// destroy an entity, its instance is removed if it has one
+		void destroyEntity(const Entity entity);
+		// set a terrain block, see World::setBlock
+		void setBlock(const glm::ivec3& cell, const BlockId id);
+		// number of queued edits
+		size_t size() const;
+		// apply every queued edit, destroys first, then placements, then terrain
+		void commit();
+	private:
+		World& world;
+		std::vector<BlockId> place_ids;
+		std::vector<glm::vec3> place_positions;
+		std::vector<Entity> destroy_entities;
+		std::vector<std::pair<glm::ivec3, BlockId>> block_edits;
+	};
+
+	World(const int view_radius = default_view_radius) noexcept;
 	~World();
 	World(const World& other) = delete;
 	World(World&& other) noexcept;
@@ -25,16 +84,84 @@ public:
 	World& operator=(World&& other) = delete;
 
 	void reset();
-	// attach instancing buffers to VAO
-	void setupInstancing(const GLuint VAO, const GLuint vertex_attrib_index, const BlockId id) const;
+	// stream chunks around the camera and rebuild the meshes of changed chunks
+	void update(const glm::vec3& camera_position);
+	// number of chunks loaded in each direction around the camera
+	void setViewRadius(const int radius);
+	int getViewRadius() const;
+	// number of chunks currently loaded
+	size_t numChunks() const;
+	// switch how terrain faces are built, remeshes every loaded chunk
+	void setMeshingMode(const ChunkMesher::Mode mode);
+	ChunkMesher::Mode getMeshingMode() const;
+	// terrain vertices across every chunk mesh
+	size_t numTerrainVertices() const;
+	// terrain triangles across every chunk mesh
+	size_t numTerrainTriangles() const;
+	// block at a world cell, air if the cell isn't loaded
+	BlockId getBlock(const glm::ivec3& cell) const;
+	// set block at a world cell, fails if the cell isn't loaded
+	bool setBlock(const glm::ivec3& cell, const BlockId id);
+	// entity of the instanced block at a world cell, entt::null if there is none
+	Entity blockEntity(const glm::ivec3& cell) const;
+	// attach instancing buffers to VAO and hand the mesh drawn with it to the gpu culler
+	void setupInstancing(const GLuint VAO, const GLuint vertex_attrib_index, const BlockId id, const std::vector<Mesh::Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Mesh::Texture>& textures) const;
+	// fails if gpu culling is asked for and the compute shader couldn't be built
+	bool setCullingMode(const CullingMode mode);
+	CullingMode getCullingMode() const;
+	// draw every instanced block the last gpu cull kept with one indirect draw, nothing in cpu culling mode
+	void drawInstancesIndirect(const Shader& shader) const;
 	// number of instancing objects for a given ID
 	size_t numObjects(const BlockId id) const;
-	// update instancing normal matrices for a given view matrix
-	void updateNormalMats(const glm::mat4& view);
+	// number of instancing objects to draw for a given ID, zero if the last cull found none of them visible
+	size_t numVisibleObjects(const BlockId id) const;
+	// first instance to draw for a given ID, changes between updates in ring buffer mode
+	size_t baseInstance(const BlockId id) const;
+	// call after the frame's draws are issued, ring buffer segments they read are protected until the gpu finishes
+	void endFrame();
+	// pick the chunks and instance buckets the following draws submit, once per render pass
+	void cull(const glm::mat4& view_projection) const;
+	// visibility counters summed over every render pass
+	struct CullStats {
+		size_t chunks_drawn = 0;
+		size_t chunks_culled = 0;
+		// chunks inside the frustum checked against the occlusion buffer
+		size_t chunks_occlusion_tested = 0;
+		size_t chunks_occluded = 0;
+		size_t instance_buckets_culled = 0;
+		size_t occluders_rasterized = 0;
+	};
+	// test chunks against the ground around the camera before drawing them
+	void setOcclusionCulling(const bool enabled);
+	bool getOcclusionCulling() const;
+	// counters of the last finished frame
+	const CullStats& getCullStats() const;
+	// queue a save of everything changed since the last one, it is written on a background thread
+	// edits made since are journaled and replayed on the next startup if the game doesn't get to save them
+	// false if nothing was queued because the journal couldn't be rotated, its edits then wait for the next save
+	bool saveAll();
+	// numbers of the last finished save
+	WorldSaver::Stats getSaveStats() const;
+	// memory kept for chunks that streamed out, evicts right away if a budget shrinks
+	void setChunkCacheBudgets(const ChunkCache::Budgets& budgets);
+	// hit, miss and eviction counters and memory use of the chunk cache
+	const ChunkCache::Stats& getChunkCacheStats() const;
+	// draw the terrain faces of a given ID for every chunk that passed the last cull, textures must already be bound
+	void drawChunks(const BlockId id) const;
 
-	// square length of world
-	static const int chunk_size = 256;
+	// square length of a chunk
+	static const int chunk_size = ChunkCoord::size;
 	static_assert((World::chunk_size % 2) == 0);
+	// default number of chunks loaded in each direction around the camera
+	static const int default_view_radius = 24;
+	// chunks unload this many chunks past the view radius, so walking along a chunk border doesn't thrash
+	static const int unload_margin = 1;
+	// chunks drop one level of detail every lod_distance chunks from the camera
+	static const int lod_distance = 6;
+	// chunks keep their level of detail until they are this many chunks past a boundary
+	inline static const float lod_hysteresis = 1.0f;
+	// maximum chunks generated per update, keeps frame times bounded while streaming
+	static const int max_chunk_loads_per_update = 16;
 	// surface variance from average height
 	static const int terrain_amplitude = 10;
 	// average surface height
@@ -43,25 +170,131 @@ public:
 	static const int max_height = 50;
 	// minimum world height
 	static const int min_height = 0;
+	static_assert((max_height - min_height) <= Chunk::height);
 	// perlin noise
 	inline static const float noise_scale = 0.01f;
-	// path to save to disk
+	// fewest instances a thread rebuilds when instancing data is rebuilt in parallel
+	static const size_t min_instance_range = 4096;
+	// chunks around the camera whose ground is rasterized as occluders
+	static const int occluder_radius = 3;
+	// where instances are culled
+	inline static const CullingMode default_culling_mode = CullingMode::Cpu;
+	// how instance data is uploaded to the gpu
+	inline static const InstanceBuffer::Mode instance_buffer_mode = InstanceBuffer::Mode::PersistentRing;
+	// path to save the seed, camera chunk and entities to
 	inline static const std::string world_path = "./world.bin";
+	// save the finished instance buckets beside world.bin, startup uses them instead of rebuilding if world.bin didn't change
+	inline static const bool cache_instances = true;
+	// path of the baked instance buckets
+	inline static const std::string instance_cache_path = "./world.instances";
+	// directory of the region files chunks are saved to
+	inline static const std::string region_path = "./regions";
+	// journal of the edits made since the last save
+	inline static const std::string journal_path = "./world.journal";
+	// bump when the layout of world.bin or a component changes, older files are discarded
+	static const uint32_t save_version = 4;
+	// time between background saves
+	static constexpr std::chrono::seconds autosave_interval{60};
+	// journaled edits are synced to disk together at most this often, a crash loses at most this much
+	static constexpr std::chrono::milliseconds journal_commit_interval{50};
+	// a journal this large is folded into a save early, so replays stay short
+	static const size_t journal_compact_size = 1 << 20;
 	// blocks are 1m wide
 	inline static constexpr float block_half_length = .5;
 private:
-	// procedurally generate registry
+	// procedurally generate all chunks within the view radius
 	void generateWorld();
-	// save all registry components to disk
-	void saveAll() const;
+	// load chunks within the view radius of the camera and unload chunks that fell out of it
+	void streamChunks(const glm::vec3& camera_position);
+	// read chunks from their region files and procedurally generate the ones never saved, on all threads
+	void loadChunks(const std::vector<ChunkCoord>& coords);
+	// read or generate chunks without loading them
+	std::vector<Chunk> readChunks(const std::vector<ChunkCoord>& coords) const;
+	// apply the edits journaled after the last save, edited chunks wait in unsaved_chunks until they stream in
+	void replayJournal();
+	// record an edit in the journal, unless it is one being replayed
+	void journalEdit(const EditJournal::Edit& edit);
+	// mark what a failed save held as unsaved again, so the next save writes it
+	void markUnsaved(WorldSaver::Snapshot&& snapshot);
+	// procedurally generate a single chunk, safe to call from any thread
+	Chunk generateChunk(const ChunkCoord& coord) const;
+	// split a world cell into its chunk and chunk local cell
+	static void splitCell(const glm::ivec3& cell, ChunkCoord& coord, glm::ivec3& local);
+	// world space box around the geometry of a chunk mesh
+	static void chunkBounds(const ChunkCoord& coord, const ChunkMesh& mesh, glm::vec3& min, glm::vec3& max);
+	// fill the occlusion buffer with the ground of the chunks around the camera
+	void rasterizeOccluders(const glm::mat4& view_projection, const Frustum& frustum) const;
+	// world position of the center of a chunk local cell
+	static glm::vec3 cellCenter(const ChunkCoord& coord, const glm::ivec3& local);
+	// loaded chunks adjacent to coord at the same level of detail
+	ChunkMesher::Neighbours neighbours(const ChunkCoord& coord) const;
+	// what a chunk would be meshed with right now
+	ChunkCache::MeshKey meshKey(const ChunkCoord& coord) const;
+	// level of detail for a chunk at the current center, current is -1 if the chunk has none yet
+	int chunkLod(const ChunkCoord& coord, const int current) const;
+	// remesh chunks whose level of detail changed after the center moved
+	void updateLods();
+	// mark a chunk for remeshing, neighbours too if their border faces may have changed
+	void queueRemesh(const ChunkCoord& coord, const bool include_neighbours);
+	// rebuild the meshes of every queued chunk
+	void remeshChunks();
+	// chunk coordinates within radius of center, closest first
+	std::vector<ChunkCoord> chunksInRadius(const ChunkCoord& center, const int radius) const;
 	// load all registry components from disk
 	bool loadAll();
-	// save registry component to disk
+	// serialize registry components if they changed and share every chunk edited since the last snapshot
 	template <typename... Component>
-	void save(const std::string& path) const;
+	WorldSaver::Snapshot snapshot();
 	// load registry component from disk
 	template <typename... Component>
 	bool load(const std::string& path);
+	// world.bin starts with a header, then one pool per component in the order they are listed
+	struct SaveHeader {
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t seed = 0;
+		int32_t center_x = 0;
+		int32_t center_z = 0;
+		uint32_t journal_generation = 0;
+		uint32_t num_pools = 0;
+	};
+	// a pool is count entity numbers followed by count raw components, components must be trivially copyable
+	struct PoolHeader {
+		// position of the component in the list
+		uint32_t tag = 0;
+		uint32_t element_size = 0;
+		uint32_t count = 0;
+		// crc of both columns
+		uint32_t crc = 0;
+	};
+	// "OGPW" in a little endian file
+	static constexpr uint32_t save_magic = 0x5750474F;
+	// world.instances starts with a header, then the size of every bucket, every bucket's instances
+	// and every bucket's entity numbers as saved in world.bin
+	struct CacheHeader {
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t instance_size = 0;
+		uint32_t num_buckets = 0;
+		// crc of the pool headers of the world.bin it was baked with
+		uint32_t source_hash = 0;
+		// crc of everything after the header
+		uint32_t crc = 0;
+	};
+	// "OGPI" in a little endian file
+	static constexpr uint32_t cache_magic = 0x4950474F;
+	// serialize the instance buckets, source_hash ties them to the world.bin written with them
+	std::string bakeInstances(const uint32_t source_hash) const;
+	// fill the instance buckets from the cache if it was baked from the world.bin just loaded, remap maps saved entity numbers
+	bool loadBakedInstances(const std::vector<Entity>& remap, const uint32_t source_hash);
+	// append an instance for a block entity at pos
+	void addInstance(const BlockId id, const Entity entity, const glm::vec3& pos);
+	// remove the instance of a block entity at pos
+	bool removeInstance(const BlockId id, const Entity entity, const glm::vec3& pos);
+	// append instances for freshly created block entities, one append per BlockId
+	void addInstances(const std::vector<Entity>& entities, const std::vector<BlockId>& ids, const std::vector<glm::vec3>& positions);
+	// world cell an instance position lies in
+	static glm::ivec3 instanceCell(const glm::vec3& pos);
 	// callback for when an entity gains both it's BlockId and Position Components
 	void onPositionBlockIdConstruct(const Registry& registry, const Entity entity);
 	// callback for when an entity loses both it's BlockId and Position Components
@@ -70,32 +303,97 @@ private:
 	void connect();
 	// remove all entt callbacks
 	void disconnect();
-	// copy data from data structures to opengl buffers
-	void initInstancingBuffers();
-	// copy data into opengl buffers, resize if needed
-	void updateInstancingBuffers(const BlockId id, const bool new_data = false, const size_t index = 0, const bool force_copy = false);
+	// make room for every instance in the gpu culler's output, nothing in cpu culling mode
+	void reserveCulledInstances();
+	// upload every instance change since the last flush, once per buffer
+	void flushInstancingBuffers();
 	// copy data from entt::registry into external data structures
 	void initInstancingData();
 	// copy data from entt::registry into external data structures and opengl buffers
 	void initData();
 
-	// invariant: model and normal vectors are the same size
-
-	// opengl buffers for instancing model matrices
-	std::vector<GLuint> instancing_model_buffers;
-	// opengl buffers for instancing normal matrices
-	std::vector<GLuint> instancing_normal_mat_buffers;
-	// number of opengl buffers to update
-	// TODO is there a better way to do this?
-	static const size_t num_unique_buffers = 2;
-	// instancing model matrices to be copied to opengl buffers
-	std::vector<std::vector<glm::mat4>> instancing_models;
-	// instancing normal matrices to be copied to opengl buffers
-	std::vector<std::vector<glm::mat3>> instancing_normal_mats;
-	// Entity component system
+	// opengl buffers for instance data, flushed once per update
+	std::vector<InstanceBuffer> instance_buffers;
+	// instance data to be copied to opengl buffers
+	std::vector<std::vector<Instance>> instances;
+	// entity that owns each instance, kept parallel to instances
+	std::vector<std::vector<Entity>> instance_entities;
+	// instance index of every instanced entity, indexed by entity number
+	std::vector<size_t> instance_slots;
+	// pack a world cell into a hash key
+	struct CellHash {
+		size_t operator()(const glm::ivec3& cell) const noexcept;
+	};
+	// instanced block entity at each world cell
+	std::unordered_map<glm::ivec3, Entity, CellHash> cell_entities;
+	CullingMode culling_mode = CullingMode::Cpu;
+	// null if the compute shader couldn't be built
+	std::unique_ptr<GpuCuller> gpu_culler;
+	// box around every instance of a BlockId
+	struct Bounds {
+		glm::vec3 min{std::numeric_limits<float>::max()};
+		glm::vec3 max{std::numeric_limits<float>::lowest()};
+	};
+	std::array<Bounds, BlockId::NumNames> instance_bounds{};
+	// results of the last cull, render state rather than world state so const draws can set it
+	mutable std::vector<const ChunkMesh*> visible_chunk_meshes;
+	mutable std::array<bool, BlockId::NumNames> visible_instance_buckets{};
+	mutable CullStats cull_stats{};
+	CullStats last_cull_stats{};
+	// depth of the nearby ground, rebuilt every cull
+	mutable OcclusionBuffer occlusion_buffer;
+	bool occlusion_culling = true;
+	// Entity component system, only holds dynamic entities, terrain lives in chunks
 	Registry world_registry;
 	// connections to ecs
 	std::vector<entt::connection> connections;
+	// voxel data of every loaded chunk, shared with background saves so edits copy a chunk a save still holds
+	std::unordered_map<ChunkCoord, std::shared_ptr<Chunk>> chunks;
+	// saved chunks, mapped a region at a time and decoded a chunk at a time as they stream in
+	// heap allocated so the saver's reference survives moving the world
+	std::unique_ptr<RegionStore> region_store;
+	// writes saves off the main thread, destroyed first so the last save finishes before the region store goes
+	std::unique_ptr<WorldSaver> saver;
+	// when the last save was queued
+	std::chrono::steady_clock::time_point last_save_time;
+	// chunks edited since the last snapshot, untouched chunks are never saved since they regenerate from the seed
+	std::unordered_set<ChunkCoord> dirty_chunks;
+	// edited chunks that unloaded before a snapshot picked them up
+	std::unordered_map<ChunkCoord, std::shared_ptr<Chunk>> unsaved_chunks;
+	// unloaded chunks a queued save holds, their region records are stale until the saver goes idle
+	std::unordered_map<ChunkCoord, std::shared_ptr<Chunk>> saving_chunks;
+	// entities, the seed or the camera chunk changed since the last snapshot
+	bool world_dirty = true;
+	// edits since the last save, so a crash doesn't lose them
+	std::unique_ptr<EditJournal> journal;
+	// when buffered journal edits were last synced
+	std::chrono::steady_clock::time_point last_journal_commit;
+	// last journal generation the loaded world.bin covers
+	uint32_t journal_generation = 0;
+	// replayed edits aren't journaled again
+	bool replaying = false;
+	// load filled the instance buckets from the cache, initData skips the rebuild once
+	bool instances_baked = false;
+	// render data of every loaded chunk
+	std::unordered_map<ChunkCoord, ChunkMesh> chunk_meshes;
+	// what each chunk mesh was built with
+	std::unordered_map<ChunkCoord, ChunkCache::MeshKey> mesh_keys;
+	// chunks and meshes that streamed out, kept under a memory budget in case the camera comes back
+	ChunkCache chunk_cache;
+	// chunks whose meshes are out of date
+	std::unordered_set<ChunkCoord> remesh_coords;
+	// level of detail each chunk is meshed at
+	std::unordered_map<ChunkCoord, int> chunk_lods;
+	// chunk the camera was in during the last update
+	ChunkCoord center_chunk{};
+	// number of chunks loaded in each direction around the camera
+	int view_radius;
+	// how terrain faces are built
+	ChunkMesher::Mode meshing_mode = ChunkMesher::Mode::Greedy;
+	// chunks within the view radius that haven't been generated yet
+	bool streaming = true;
+	// terrain noise seed, saved so unloaded chunks regenerate identically
+	uint32_t seed = 0;
 };
 
 #endif
\ No newline at end of file
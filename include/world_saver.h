@@ -0,0 +1,78 @@
+#ifndef WORLD_SAVER_H
+#define WORLD_SAVER_H
+
+#include "region_store.h"
+
+#include <string>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// writes world snapshots on a worker thread so a save never stalls a frame
+class WorldSaver
+{
+public:
+	// everything one save writes, taken on the main thread so it is consistent
+	struct Snapshot {
+		// seed, camera chunk and entities, already serialized, world.bin is left alone if empty
+		std::string world_bytes;
+		// baked instance buckets matching world_bytes, the cache is left alone if empty
+		std::string cache_bytes;
+		// chunks to write, shared so the world copies any chunk it edits while a save still holds it
+		RegionStore::ChunkRefs chunks;
+	};
+	// numbers of the last finished save
+	struct Stats {
+		double seconds = 0.0;
+		size_t bytes_written = 0;
+		size_t num_chunks = 0;
+		bool success = false;
+	};
+
+	// region_store must outlive the saver
+	WorldSaver(const RegionStore& region_store, const std::string& world_path, const std::string& cache_path);
+	// writes the queued snapshot before returning
+	~WorldSaver();
+	WorldSaver(const WorldSaver& other) = delete;
+	WorldSaver(WorldSaver&& other) = delete;
+	WorldSaver& operator=(const WorldSaver& other) = delete;
+	WorldSaver& operator=(WorldSaver&& other) = delete;
+
+	// queue a snapshot, it is merged into a queued snapshot that hasn't started writing yet
+	void save(Snapshot&& snapshot);
+	// block until every queued snapshot is written
+	void wait();
+	// true while a snapshot is queued or being written
+	bool busy() const;
+	Stats getStats() const;
+	// every snapshot that failed to write since the last call merged into one, nothing if all of them succeeded
+	std::optional<Snapshot> takeFailed();
+
+private:
+	// fold a newer snapshot into an older one, the newer one wins where both hold something
+	static void merge(std::optional<Snapshot>& into, Snapshot&& snapshot);
+	// worker loop, writes snapshots until stopping
+	void run();
+	// write one snapshot to disk
+	Stats write(const Snapshot& snapshot) const;
+	// replace the file at path with bytes, sync first if the file must survive a power loss
+	static bool replaceFile(const std::string& path, const std::string& bytes, const bool sync);
+
+	const RegionStore& region_store;
+	std::string world_path;
+	std::string cache_path;
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	std::optional<Snapshot> queued;
+	// kept so the world can mark what they held as unsaved again
+	std::optional<Snapshot> failed;
+	bool writing = false;
+	bool stopping = false;
+	Stats stats{};
+	// started last so every member above exists before the worker reads it
+	std::thread worker;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "chunk.h"
+
+#include "component.h"
+#include "utils.h"
+
+#include "glm/vec3.hpp"
+#include "glm/ext/vector_int3.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+ChunkCoord ChunkCoord::fromPosition(const glm::vec3& position)
+{
+	return ChunkCoord{
+		static_cast<int>(std::floor(position.x / size)),
+		static_cast<int>(std::floor(position.z / size))
+	};
+}
+
+glm::vec3 ChunkCoord::origin() const
+{
+	return glm::vec3(x * size, 0.0f, z * size);
+}
+
+int ChunkCoord::distanceSquared(const ChunkCoord& other) const
+{
+	const int dx = x - other.x;
+	const int dz = z - other.z;
+	return (dx * dx) + (dz * dz);
+}
+
+Chunk::Chunk() noexcept :
+	palette{BlockId::Name::None},
+	cells(volume, air)
+{}
+
+BlockId Chunk::get(const glm::ivec3& local) const
+{
+	if (!contains(local)) {
+		return BlockId::Name::None;
+	}
+
+	return palette[cells[index(local)]];
+}
+
+bool Chunk::set(const glm::ivec3& local, const BlockId id)
+{
+	if (!contains(local)) {
+		LOG("Cell is outside of the chunk")
+		return false;
+	}
+
+	size_t palette_index = 0;
+	while ((palette_index < palette.size()) && (palette[palette_index] != id.name)) {
+		palette_index++;
+	}
+	if (palette_index == palette.size()) {
+		if (palette.size() > std::numeric_limits<uint8_t>::max()) {
+			LOG("Chunk palette is full")
+			return false;
+		}
+		palette.push_back(id);
+	}
+
+	uint8_t& cell = cells[index(local)];
+	const bool was_solid = (cell != air);
+	num_blocks -= was_solid;
+	cell = static_cast<uint8_t>(palette_index);
+	num_blocks += (cell != air);
+
+	if (cell != air) {
+		lowest_block = std::min(lowest_block, local.y);
+		highest_block = std::max(highest_block, local.y);
+	} else if (was_solid && ((local.y == lowest_block) || (local.y == highest_block))) {
+		findBlockHeights();
+	}
+
+	return true;
+}
+
+bool Chunk::isSolid(const glm::ivec3& local) const
+{
+	return contains(local) && (cells[index(local)] != air);
+}
+
+size_t Chunk::numBlocks() const
+{
+	return num_blocks;
+}
+
+int Chunk::lowestBlock() const
+{
+	return lowest_block;
+}
+
+int Chunk::highestBlock() const
+{
+	return highest_block;
+}
+
+size_t Chunk::memoryUsage() const
+{
+	return sizeof(Chunk) + (palette.capacity() * sizeof(BlockId)) + cells.capacity();
+}
+
+bool Chunk::contains(const glm::ivec3& local)
+{
+	return (local.x >= 0) && (local.x < size) &&
+		(local.y >= 0) && (local.y < height) &&
+		(local.z >= 0) && (local.z < size);
+}
+
+size_t Chunk::index(const glm::ivec3& local)
+{
+	return (((local.x * size) + local.z) * height) + local.y;
+}
+
+void Chunk::encode(std::vector<uint8_t>& out) const
+{
+	utils::writeVarint(out, palette.size());
+	for (const BlockId id : palette) {
+		utils::writeVarint(out, id.uint());
+	}
+
+	// columns are contiguous, so terrain collapses into a few runs per column
+	for (size_t i = 0; i < cells.size();) {
+		size_t run = 1;
+		while (((i + run) < cells.size()) && (cells[i + run] == cells[i])) {
+			run++;
+		}
+		utils::writeVarint(out, run);
+		out.push_back(cells[i]);
+		i += run;
+	}
+}
+
+bool Chunk::decode(const uint8_t* data, const size_t size)
+{
+	const uint8_t* pos = data;
+	const uint8_t* const end = data + size;
+	*this = Chunk();
+
+	uint64_t palette_size = 0;
+	if (!utils::readVarint(pos, end, palette_size) || (palette_size == 0) || (palette_size > 256)) return false;
+	palette.resize(palette_size);
+	for (BlockId& id : palette) {
+		uint64_t name = 0;
+		if (!utils::readVarint(pos, end, name) || (name > static_cast<uint64_t>(BlockId::Name::None))) return false;
+		id = BlockId(static_cast<unsigned int>(name));
+	}
+	if (palette[air] != BlockId::Name::None) return false;
+
+	for (size_t i = 0; i < volume;) {
+		uint64_t run = 0;
+		if (!utils::readVarint(pos, end, run) || (pos == end) || (run == 0) || (run > (volume - i))) return false;
+		const uint8_t palette_index = *pos++;
+		if (palette_index >= palette.size()) return false;
+
+		std::fill_n(cells.begin() + i, run, palette_index);
+		num_blocks += (palette_index != air) * run;
+		if (palette_index != air) {
+			// a run that wraps into the next column covers its top and the next one's bottom
+			const int first_y = static_cast<int>(i % height);
+			const int last_y = first_y + static_cast<int>(run) - 1;
+			lowest_block = std::min(lowest_block, (last_y < height) ? first_y : 0);
+			highest_block = std::max(highest_block, std::min(last_y, height - 1));
+		}
+		i += run;
+	}
+
+	return pos == end;
+}
+
+void Chunk::findBlockHeights()
+{
+	lowest_block = height;
+	highest_block = -1;
+	for (size_t i = 0; i < cells.size(); i++) {
+		if (cells[i] != air) {
+			const int y = static_cast<int>(i % height);
+			lowest_block = std::min(lowest_block, y);
+			highest_block = std::max(highest_block, y);
+		}
+	}
+}
+
+size_t std::hash<ChunkCoord>::operator()(const ChunkCoord& coord) const noexcept
+{
+	// pack both 32 bit coordinates into one 64 bit key
+	const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(coord.x)) << 32) | static_cast<uint32_t>(coord.z);
+	return std::hash<uint64_t>{}(key);
+}
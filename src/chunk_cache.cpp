@@ -0,0 +1,103 @@
+#include "chunk_cache.h"
+
+#include "chunk.h"
+#include "chunk_mesher.h"
+#include "chunk_mesh.h"
+#include "mesh.h"
+
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+ChunkCache::ChunkCache() noexcept :
+	ChunkCache(Budgets{})
+{}
+
+ChunkCache::ChunkCache(const Budgets& budgets) noexcept :
+	budgets(budgets)
+{}
+
+void ChunkCache::putChunk(const ChunkCoord& coord, std::shared_ptr<Chunk> chunk)
+{
+	const size_t bytes = chunk->memoryUsage();
+	voxels.put(coord, MeshKey{}, std::move(chunk), bytes, budgets.voxel_bytes, stats.voxels);
+}
+
+std::shared_ptr<Chunk> ChunkCache::takeChunk(const ChunkCoord& coord)
+{
+	auto* entry = voxels.find(coord, MeshKey{}, stats.voxels);
+	if (!entry) return nullptr;
+
+	std::shared_ptr<Chunk> chunk = std::move(entry->value);
+	voxels.erase(coord, stats.voxels);
+	return chunk;
+}
+
+void ChunkCache::putMeshData(const ChunkCoord& coord, const MeshKey& key, ChunkMesher::MeshData&& data)
+{
+	const size_t bytes = meshDataBytes(data);
+	mesh_data.put(coord, key, std::move(data), bytes, budgets.mesh_data_bytes, stats.mesh_data);
+}
+
+const ChunkMesher::MeshData* ChunkCache::findMeshData(const ChunkCoord& coord, const MeshKey& key)
+{
+	const auto* entry = mesh_data.find(coord, key, stats.mesh_data);
+	return entry ? &entry->value : nullptr;
+}
+
+void ChunkCache::putMesh(const ChunkCoord& coord, const MeshKey& key, ChunkMesh&& mesh)
+{
+	const size_t bytes = mesh.gpuBytes();
+	gpu_meshes.put(coord, key, std::move(mesh), bytes, budgets.gpu_bytes, stats.gpu_meshes);
+}
+
+bool ChunkCache::takeMesh(const ChunkCoord& coord, const MeshKey& key, ChunkMesh& mesh)
+{
+	auto* entry = gpu_meshes.find(coord, key, stats.gpu_meshes);
+	if (!entry) return false;
+
+	mesh = std::move(entry->value);
+	gpu_meshes.erase(coord, stats.gpu_meshes);
+	return true;
+}
+
+void ChunkCache::invalidateMeshes(const ChunkCoord& coord)
+{
+	mesh_data.erase(coord, stats.mesh_data);
+	gpu_meshes.erase(coord, stats.gpu_meshes);
+}
+
+void ChunkCache::clearMeshes()
+{
+	mesh_data.clear(stats.mesh_data);
+	gpu_meshes.clear(stats.gpu_meshes);
+}
+
+void ChunkCache::clear()
+{
+	voxels.clear(stats.voxels);
+	clearMeshes();
+}
+
+void ChunkCache::setBudgets(const Budgets& new_budgets)
+{
+	budgets = new_budgets;
+	voxels.evict(budgets.voxel_bytes, stats.voxels);
+	mesh_data.evict(budgets.mesh_data_bytes, stats.mesh_data);
+	gpu_meshes.evict(budgets.gpu_bytes, stats.gpu_meshes);
+}
+
+const ChunkCache::Budgets& ChunkCache::getBudgets() const
+{
+	return budgets;
+}
+
+const ChunkCache::Stats& ChunkCache::getStats() const
+{
+	return stats;
+}
+
+size_t ChunkCache::meshDataBytes(const ChunkMesher::MeshData& data)
+{
+	return sizeof(ChunkMesher::MeshData) + (data.vertices.capacity() * sizeof(Mesh::Vertex)) + (data.indices.capacity() * sizeof(unsigned int));
+}
@@ -0,0 +1,146 @@
+#include "chunk_mesh.h"
+
+#include "chunk_mesher.h"
+#include "mesh.h"
+#include "component.h"
+#include "instance.h"
+
+#include "glad/gl.h"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/common.hpp"
+
+#include <cstddef>
+#include <utility>
+
+ChunkMesh::ChunkMesh(const ChunkMesher::MeshData& data, const glm::vec3& position) noexcept :
+	occluder_heights(data.occluder_heights),
+	bottom_height(data.bottom),
+	top_height(data.top)
+{
+	if (!data.indices.empty()) {
+		setupMesh(data, position);
+	}
+}
+
+ChunkMesh::~ChunkMesh()
+{
+	free();
+}
+
+ChunkMesh::ChunkMesh(ChunkMesh&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+ChunkMesh& ChunkMesh::operator=(ChunkMesh&& other) noexcept
+{
+	if (this != &other) {
+		free();
+		VAO = std::exchange(other.VAO, 0);
+		VBO = std::exchange(other.VBO, 0);
+		EBO = std::exchange(other.EBO, 0);
+		instance_buffer = std::exchange(other.instance_buffer, 0);
+		ranges = std::exchange(other.ranges, {});
+		num_vertices = std::exchange(other.num_vertices, 0);
+		num_indices = std::exchange(other.num_indices, 0);
+		occluder_heights = std::exchange(other.occluder_heights, {});
+		bottom_height = std::exchange(other.bottom_height, 0);
+		top_height = std::exchange(other.top_height, 0);
+	}
+	return *this;
+}
+
+void ChunkMesh::draw(const BlockId id) const
+{
+	const ChunkMesher::IndexRange& range = ranges[id.uint()];
+	if ((VAO == 0) || (range.count == 0)) return;
+
+	glBindVertexArray(VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, range.count, GL_UNSIGNED_INT, (void*)(range.first * sizeof(unsigned int)), 1);
+}
+
+size_t ChunkMesh::numVertices() const
+{
+	return num_vertices;
+}
+
+size_t ChunkMesh::numIndices() const
+{
+	return num_indices;
+}
+
+size_t ChunkMesh::gpuBytes() const
+{
+	return (num_vertices * sizeof(Mesh::Vertex)) + (num_indices * sizeof(unsigned int)) + origin_bytes;
+}
+
+const std::array<int, 4>& ChunkMesh::occluderHeights() const
+{
+	return occluder_heights;
+}
+
+int ChunkMesh::bottom() const
+{
+	return bottom_height;
+}
+
+int ChunkMesh::top() const
+{
+	return top_height;
+}
+
+void ChunkMesh::setupMesh(const ChunkMesher::MeshData& data, const glm::vec3& position)
+{
+	using Vertex = Mesh::Vertex;
+	ranges = data.ranges;
+	num_vertices = data.vertices.size();
+	num_indices = data.indices.size();
+
+	glCreateBuffers(1, &VBO);
+	glNamedBufferData(VBO, data.vertices.size() * sizeof(Vertex), data.vertices.data(), GL_STATIC_DRAW);
+	glCreateBuffers(1, &EBO);
+	glNamedBufferData(EBO, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+	glCreateBuffers(1, &instance_buffer);
+	if constexpr (PACKED_INSTANCES) {
+		// chunks stream past the int16 cells of a packed instance, the cell goes in as floats the shader reads the same way
+		const glm::vec4 origin(glm::floor(position), 0.0f);
+		glNamedBufferData(instance_buffer, sizeof(glm::vec4), &origin, GL_STATIC_DRAW);
+	} else {
+		const Instance instance = Instance::fromPosition(position);
+		glNamedBufferData(instance_buffer, sizeof(Instance), &instance, GL_STATIC_DRAW);
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+	// same layout as Mesh so the block shaders can be reused
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	if constexpr (PACKED_INSTANCES) {
+		glEnableVertexAttribArray(instance_vertex_attrib_index);
+		glVertexAttribPointer(instance_vertex_attrib_index, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+		glVertexAttribDivisor(instance_vertex_attrib_index, 1);
+	} else {
+		Instance::setupAttribs(instance_vertex_attrib_index);
+	}
+
+	glBindVertexArray(0);
+}
+
+void ChunkMesh::free()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &instance_buffer);
+	VAO = VBO = EBO = instance_buffer = 0;
+}
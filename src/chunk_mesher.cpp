@@ -0,0 +1,307 @@
+#include "chunk_mesher.h"
+
+#include "mesh.h"
+#include "chunk.h"
+#include "component.h"
+
+#include "glm/vec3.hpp"
+#include "glm/vec2.hpp"
+#include "glm/ext/vector_int3.hpp"
+#include "glm/geometric.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// texture axes follow the block model's uv layout so merged faces look the same as single blocks
+const std::array<ChunkMesher::Face, 6> ChunkMesher::faces = {{
+	// +y
+	{{0, 1, 0},
+		{{{0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}}},
+		{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+	// +z
+	{{0, 0, 1},
+		{{{0.5f, -0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}, {-0.5f, 0.5f, 0.5f}, {-0.5f, -0.5f, 0.5f}}},
+		{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+	// -x
+	{{-1, 0, 0},
+		{{{-0.5f, -0.5f, 0.5f}, {-0.5f, 0.5f, 0.5f}, {-0.5f, 0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}}},
+		{0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}},
+	// -y
+	{{0, -1, 0},
+		{{{-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, 0.5f}, {-0.5f, -0.5f, 0.5f}}},
+		{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+	// +x
+	{{1, 0, 0},
+		{{{0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}}},
+		{0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}},
+	// -z
+	{{0, 0, -1},
+		{{{-0.5f, -0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f}, {0.5f, 0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}}},
+		{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+}};
+
+ChunkMesher::MeshData ChunkMesher::mesh(const Chunk& chunk, const Neighbours& neighbours, const Mode mode, const int lod)
+{
+	const Volume volume(chunk, neighbours, std::clamp(lod, 0, num_lods - 1));
+	Geometry geometry;
+	if (mode == Mode::Greedy) {
+		meshGreedy(geometry, volume);
+	} else {
+		meshCulled(geometry, volume);
+	}
+
+	// pack every block id into a single vertex and index buffer
+	MeshData data;
+	data.occluder_heights = occluderHeights(chunk);
+	if (chunk.numBlocks() > 0) {
+		// a coarse cell can only be solid if it holds a block, so whole cells around the blocks bound it
+		const int scale = volume.scale();
+		data.bottom = (chunk.lowestBlock() / scale) * scale;
+		data.top = ((chunk.highestBlock() / scale) + 1) * scale;
+	}
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		const unsigned int vertex_offset = static_cast<unsigned int>(data.vertices.size());
+		data.ranges[i] = IndexRange{data.indices.size(), geometry.indices[i].size()};
+		data.vertices.insert(data.vertices.end(), geometry.vertices[i].begin(), geometry.vertices[i].end());
+		for (const unsigned int index : geometry.indices[i]) {
+			data.indices.push_back(vertex_offset + index);
+		}
+	}
+
+	return data;
+}
+
+void ChunkMesher::addQuad(Geometry& geometry, const BlockId id, const Face& face, const glm::ivec3& min_cell, const glm::ivec3& max_cell, const int scale)
+{
+	std::vector<Mesh::Vertex>& vertices = geometry.vertices[id.uint()];
+	std::vector<unsigned int>& indices = geometry.indices[id.uint()];
+	const glm::vec3 min_center(min_cell);
+	const glm::vec3 max_center(max_cell);
+
+	const unsigned int first_vertex = static_cast<unsigned int>(vertices.size());
+	for (const glm::vec3& corner : face.corners) {
+		// stretch the unit face so each corner lands on the matching corner of the rectangle, then scale cells up to blocks
+		glm::vec3 position;
+		for (int axis = 0; axis < 3; axis++) {
+			const float cell_position = corner[axis] + ((corner[axis] < 0.0f) ? min_center[axis] : max_center[axis]);
+			position[axis] = ((cell_position + 0.5f) * scale) - 0.5f;
+		}
+		// block edges fall on whole texture coordinates so GL_REPEAT tiles one texture per block
+		const glm::vec2 tex_coords(glm::dot(position, face.u_axis) + 0.5f, glm::dot(position, face.v_axis) + 0.5f);
+
+		vertices.push_back(Mesh::Vertex{
+			.Position = position,
+			.Normal = glm::vec3(face.normal),
+			.TexCoords = tex_coords
+		});
+	}
+	// two counter clockwise triangles per quad
+	for (const unsigned int corner : {0u, 1u, 2u, 0u, 2u, 3u}) {
+		indices.push_back(first_vertex + corner);
+	}
+}
+
+void ChunkMesher::meshCulled(Geometry& geometry, const Volume& volume)
+{
+	const glm::ivec3& dims = volume.dims();
+	for (int x = 0; x < dims.x; x++) {
+		for (int z = 0; z < dims.z; z++) {
+			for (int y = 0; y < dims.y; y++) {
+				const glm::ivec3 local(x, y, z);
+				const BlockId id = volume.get(local);
+				if (id == BlockId::Name::None) continue;
+
+				for (const Face& face : faces) {
+					if (!volume.isSolid(local + face.normal)) {
+						addQuad(geometry, id, face, local, local, volume.scale());
+					}
+				}
+			}
+		}
+	}
+}
+
+void ChunkMesher::meshGreedy(Geometry& geometry, const Volume& volume)
+{
+	const glm::ivec3& dims = volume.dims();
+	// visible faces of the current slice, zero is no face, otherwise block id + 1
+	std::vector<uint8_t> mask;
+
+	for (const Face& face : faces) {
+		// axis the face points along and the two axes the face spans
+		const int normal_axis = (face.normal.x != 0) ? 0 : ((face.normal.y != 0) ? 1 : 2);
+		const int a = (normal_axis + 1) % 3;
+		const int b = (normal_axis + 2) % 3;
+		mask.assign(dims[a] * dims[b], 0);
+
+		for (int slice = 0; slice < dims[normal_axis]; slice++) {
+			glm::ivec3 cell;
+			cell[normal_axis] = slice;
+			for (int j = 0; j < dims[b]; j++) {
+				for (int i = 0; i < dims[a]; i++) {
+					cell[a] = i;
+					cell[b] = j;
+					const BlockId id = volume.get(cell);
+					const bool visible = (id != BlockId::Name::None) && !volume.isSolid(cell + face.normal);
+					mask[(j * dims[a]) + i] = visible ? static_cast<uint8_t>(id.uint() + 1) : 0;
+				}
+			}
+
+			for (int j = 0; j < dims[b]; j++) {
+				for (int i = 0; i < dims[a];) {
+					const uint8_t value = mask[(j * dims[a]) + i];
+					if (value == 0) {
+						i++;
+						continue;
+					}
+
+					// grow along a as far as the face matches, then along b while the whole row matches
+					int width = 1;
+					while (((i + width) < dims[a]) && (mask[(j * dims[a]) + i + width] == value)) {
+						width++;
+					}
+					int height = 1;
+					for (bool row_matches = true; row_matches && ((j + height) < dims[b]); ) {
+						for (int k = 0; k < width; k++) {
+							row_matches &= (mask[((j + height) * dims[a]) + i + k] == value);
+						}
+						height += row_matches;
+					}
+
+					for (int h = 0; h < height; h++) {
+						for (int w = 0; w < width; w++) {
+							mask[((j + h) * dims[a]) + i + w] = 0;
+						}
+					}
+
+					glm::ivec3 min_cell = cell;
+					min_cell[a] = i;
+					min_cell[b] = j;
+					glm::ivec3 max_cell = min_cell;
+					max_cell[a] += width - 1;
+					max_cell[b] += height - 1;
+					addQuad(geometry, BlockId(static_cast<unsigned int>(value - 1)), face, min_cell, max_cell, volume.scale());
+
+					i += width;
+				}
+			}
+		}
+	}
+}
+
+std::array<int, 4> ChunkMesher::occluderHeights(const Chunk& chunk)
+{
+	constexpr int half_size = Chunk::size / 2;
+	std::array<int, 4> heights;
+	heights.fill(Chunk::height);
+	for (int x = 0; x < Chunk::size; x++) {
+		for (int z = 0; z < Chunk::size; z++) {
+			int column_height = 0;
+			while ((column_height < Chunk::height) && chunk.isSolid(glm::ivec3(x, column_height, z))) {
+				column_height++;
+			}
+			int& quarter_height = heights[(x / half_size) + ((z / half_size) * 2)];
+			quarter_height = std::min(quarter_height, column_height);
+		}
+	}
+	return heights;
+}
+
+ChunkMesher::Volume::Volume(const Chunk& chunk, const Neighbours& neighbours, const int lod) :
+	size(Chunk::size >> lod, Chunk::height >> lod, Chunk::size >> lod),
+	cell_scale(1 << lod),
+	cells((size.x + 2) * (size.y + 2) * (size.z + 2), 0)
+{
+	for (int x = -1; x <= size.x; x++) {
+		for (int z = -1; z <= size.z; z++) {
+			// pick the chunk that owns this column, corners are never sampled by face culling
+			const Chunk* source = &chunk;
+			glm::ivec3 source_cell(x, 0, z);
+			if (x < 0) {
+				source = neighbours[1];
+				source_cell.x += size.x;
+			} else if (x >= size.x) {
+				source = neighbours[0];
+				source_cell.x -= size.x;
+			} else if (z < 0) {
+				source = neighbours[3];
+				source_cell.z += size.z;
+			} else if (z >= size.z) {
+				source = neighbours[2];
+				source_cell.z -= size.z;
+			}
+			if (!source) continue;
+
+			// nothing is visible from below the world, treat it as solid
+			cells[index(glm::ivec3(x, -1, z))] = 1;
+			for (int y = 0; y < size.y; y++) {
+				source_cell.y = y;
+				cells[index(glm::ivec3(x, y, z))] = sample(*source, source_cell, cell_scale);
+			}
+		}
+	}
+}
+
+const glm::ivec3& ChunkMesher::Volume::dims() const
+{
+	return size;
+}
+
+int ChunkMesher::Volume::scale() const
+{
+	return cell_scale;
+}
+
+BlockId ChunkMesher::Volume::get(const glm::ivec3& local) const
+{
+	const uint8_t cell = cells[index(local)];
+	return (cell == 0) ? BlockId(BlockId::Name::None) : BlockId(static_cast<unsigned int>(cell - 1));
+}
+
+bool ChunkMesher::Volume::isSolid(const glm::ivec3& local) const
+{
+	return cells[index(local)] != 0;
+}
+
+size_t ChunkMesher::Volume::index(const glm::ivec3& local) const
+{
+	return ((((local.x + 1) * (size.z + 2)) + (local.z + 1)) * (size.y + 2)) + (local.y + 1);
+}
+
+uint8_t ChunkMesher::Volume::sample(const Chunk& chunk, const glm::ivec3& cell, const int scale)
+{
+	const glm::ivec3 first_block = cell * scale;
+	if (scale == 1) {
+		const BlockId id = chunk.get(first_block);
+		return (id == BlockId::Name::None) ? 0 : static_cast<uint8_t>(id.uint() + 1);
+	}
+
+	int num_solid = 0;
+	for (int x = 0; x < scale; x++) {
+		for (int z = 0; z < scale; z++) {
+			for (int y = 0; y < scale; y++) {
+				num_solid += chunk.isSolid(first_block + glm::ivec3(x, y, z));
+			}
+		}
+	}
+	if ((num_solid * 2) < (scale * scale * scale)) return 0;
+
+	// blocks outside the chunk read as air, so looking above the top cell is safe
+	uint8_t top = 0;
+	int top_y = -1;
+	for (int x = 0; x < scale; x++) {
+		for (int z = 0; z < scale; z++) {
+			for (int y = (2 * scale) - 1; y > top_y; y--) {
+				const BlockId id = chunk.get(first_block + glm::ivec3(x, y, z));
+				if (id != BlockId::Name::None) {
+					top = static_cast<uint8_t>(id.uint() + 1);
+					top_y = y;
+					break;
+				}
+			}
+		}
+	}
+	return top;
+}
@@ -0,0 +1,342 @@
+#include "edit_journal.h"
+
+#include "component.h"
+#include "utils.h"
+
+#include "glm/vec3.hpp"
+#include "glm/ext/vector_int3.hpp"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <charconv>
+#include <bit>
+#include <filesystem>
+#include <system_error>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+EditJournal::EditJournal(const std::string& path) :
+	path(path),
+	worker(&EditJournal::run, this)
+{}
+
+EditJournal::~EditJournal()
+{
+	commit();
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+bool EditJournal::open(const uint32_t seed, const uint32_t saved_generation, std::vector<Edit>& edits)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]() { return !writing; });
+	this->seed = seed;
+	stream.close();
+	pending.clear();
+	committed.clear();
+	rotated_generations.clear();
+	edits.clear();
+
+	struct Journal {
+		uint32_t generation;
+		std::string path;
+		std::vector<Edit> edits;
+	};
+	std::vector<Journal> journals;
+	generation = saved_generation + 1;
+	std::error_code error;
+	for (const std::string& journal_path : journalPaths()) {
+		Header header;
+		std::vector<Edit> journal_edits;
+		if (!readJournal(journal_path, header, journal_edits) || (header.seed != seed) || (header.generation <= saved_generation)) {
+			std::filesystem::remove(journal_path, error);
+			continue;
+		}
+		generation = std::max(generation, header.generation + 1);
+		if (journal_edits.empty()) {
+			std::filesystem::remove(journal_path, error);
+		} else {
+			journals.push_back(Journal{header.generation, journal_path, std::move(journal_edits)});
+		}
+	}
+
+	std::sort(journals.begin(), journals.end(), [](const Journal& one, const Journal& two) {
+		return one.generation < two.generation;
+	});
+	for (Journal& journal : journals) {
+		edits.insert(edits.end(), journal.edits.begin(), journal.edits.end());
+		// kept until a save holds its edits, the current file moves aside so the new one starts empty
+		if (journal.path == path) {
+			std::filesystem::rename(path, rotatedPath(journal.generation), error);
+			if (error) {
+				LOG("Unable to rotate journal " << path)
+				return false;
+			}
+		}
+		rotated_generations.push_back(journal.generation);
+	}
+
+	return startFile();
+}
+
+bool EditJournal::reset(const uint32_t seed)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]() { return !writing; });
+	this->seed = seed;
+	stream.close();
+	pending.clear();
+	committed.clear();
+	rotated_generations.clear();
+	std::error_code error;
+	for (const std::string& journal_path : journalPaths()) {
+		std::filesystem::remove(journal_path, error);
+	}
+
+	generation = 1;
+	return startFile();
+}
+
+void EditJournal::append(const Edit& edit)
+{
+	encode(edit, pending);
+}
+
+void EditJournal::commit()
+{
+	if (pending.empty()) return;
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		committed.insert(committed.end(), pending.begin(), pending.end());
+	}
+	pending.clear();
+	condition.notify_all();
+}
+
+EditJournal::Rotation EditJournal::rotate()
+{
+	// the snapshot taken with this rotation holds every edit so far, so they go in the rotated file
+	commit();
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]() { return !writing; });
+	if (!committed.empty()) {
+		// renaming now would leave them to the next generation, which the save doesn't cover
+		if (!writeRecords(committed)) return Rotation::Failed;
+		committed.clear();
+	}
+	if (file_size <= sizeof(Header)) return Rotation::Empty;
+
+	stream.close();
+	std::error_code error;
+	std::filesystem::rename(path, rotatedPath(generation), error);
+	if (error) {
+		// keep appending to the same file, the next save tries again
+		LOG("Unable to rotate journal " << path)
+		return Rotation::Failed;
+	}
+	rotated_generations.push_back(generation);
+	generation++;
+	startFile();
+	return Rotation::Rotated;
+}
+
+void EditJournal::dropRotated()
+{
+	std::error_code error;
+	for (const uint32_t rotated_generation : rotated_generations) {
+		std::filesystem::remove(rotatedPath(rotated_generation), error);
+	}
+	rotated_generations.clear();
+}
+
+bool EditJournal::hasRotated() const
+{
+	return !rotated_generations.empty();
+}
+
+bool EditJournal::hasPending() const
+{
+	return !pending.empty();
+}
+
+size_t EditJournal::size() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return file_size + committed.size() + pending.size();
+}
+
+uint32_t EditJournal::coveredGeneration() const
+{
+	return generation - 1;
+}
+
+void EditJournal::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [this]() { return !committed.empty() || stopping; });
+		// stopping still writes whatever is committed
+		if (committed.empty()) return;
+
+		std::vector<uint8_t> bytes = std::move(committed);
+		committed.clear();
+		writing = true;
+		lock.unlock();
+
+		const bool written = writeRecords(bytes);
+
+		lock.lock();
+		writing = false;
+		condition.notify_all();
+		if (!written) {
+			// kept ahead of anything committed since, retried with the next commit instead of spinning on a full disk
+			const size_t failed_size = bytes.size();
+			committed.insert(committed.begin(), bytes.begin(), bytes.end());
+			if (stopping) return;
+			condition.wait(lock, [this, failed_size]() { return stopping || (committed.size() > failed_size); });
+		}
+	}
+}
+
+bool EditJournal::writeRecords(const std::vector<uint8_t>& bytes)
+{
+	if (!stream.is_open()) {
+		// a failed write can leave part of a record behind, and replay stops at the first torn record
+		std::error_code error;
+		std::filesystem::resize_file(path, file_size, error);
+		if (error) {
+			LOG("Unable to truncate journal " << path)
+			return false;
+		}
+		stream.open(path, std::ios::out | std::ios::app | std::ios::binary);
+	}
+	stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	stream.flush();
+	if (!stream || !utils::syncFile(path)) {
+		LOG("Unable to write journal " << path)
+		// reopened and cut back to file_size before the next write
+		stream.close();
+		stream.clear();
+		return false;
+	}
+
+	file_size += bytes.size();
+	return true;
+}
+
+bool EditJournal::startFile()
+{
+	stream.close();
+	stream.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+	const Header header{magic, version, seed, generation};
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	stream.flush();
+	if (!stream || !utils::syncFile(path)) {
+		LOG("Unable to start journal " << path)
+		return false;
+	}
+
+	file_size = sizeof(Header);
+	return true;
+}
+
+std::string EditJournal::rotatedPath(const uint32_t generation) const
+{
+	return path + "." + std::to_string(generation);
+}
+
+std::vector<std::string> EditJournal::journalPaths() const
+{
+	std::vector<std::string> paths{path};
+	const std::filesystem::path journal_path(path);
+	const std::string prefix = journal_path.filename().string() + ".";
+	const std::filesystem::path directory = journal_path.has_parent_path() ? journal_path.parent_path() : ".";
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		const std::string name = entry.path().filename().string();
+		const char* const end = name.data() + name.size();
+		uint32_t number = 0;
+		if (name.starts_with(prefix) && (std::from_chars(name.data() + prefix.size(), end, number).ptr == end)) {
+			paths.push_back(rotatedPath(number));
+		}
+	}
+	return paths;
+}
+
+bool EditJournal::readJournal(const std::string& path, Header& header, std::vector<Edit>& edits)
+{
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+	if (!stream) return false;
+	const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+	if (bytes.size() < sizeof(Header)) return false;
+
+	std::memcpy(&header, bytes.data(), sizeof(Header));
+	if ((header.magic != magic) || (header.version != version)) return false;
+
+	for (size_t pos = sizeof(Header); (pos + record_size) <= bytes.size(); pos += record_size) {
+		uint32_t size = 0;
+		uint32_t crc = 0;
+		std::memcpy(&size, bytes.data() + pos, sizeof(uint32_t));
+		std::memcpy(&crc, bytes.data() + pos + sizeof(uint32_t), sizeof(uint32_t));
+		const uint8_t* payload = bytes.data() + pos + (2 * sizeof(uint32_t));
+		// a crash mid commit leaves a partial record, everything before it was synced
+		if ((size != payload_size) || (utils::crc32(payload, payload_size) != crc)
+			|| (payload[0] > static_cast<uint8_t>(Edit::Type::DestroyEntity))) break;
+
+		edits.push_back(decode(payload));
+	}
+
+	return true;
+}
+
+void EditJournal::encode(const Edit& edit, std::vector<uint8_t>& out)
+{
+	std::array<uint8_t, payload_size> payload{};
+	payload[0] = static_cast<uint8_t>(edit.type);
+	std::array<uint32_t, 4> fields{edit.id.uint()};
+	for (int i = 0; i < 3; i++) {
+		fields[i + 1] = (edit.type == Edit::Type::SetBlock) ? std::bit_cast<uint32_t>(edit.cell[i]) : std::bit_cast<uint32_t>(edit.pos[i]);
+	}
+	std::memcpy(payload.data() + 1, fields.data(), sizeof(fields));
+
+	const uint32_t size = payload_size;
+	const uint32_t crc = utils::crc32(payload.data(), payload_size);
+	const uint8_t* header = reinterpret_cast<const uint8_t*>(&size);
+	out.insert(out.end(), header, header + sizeof(uint32_t));
+	header = reinterpret_cast<const uint8_t*>(&crc);
+	out.insert(out.end(), header, header + sizeof(uint32_t));
+	out.insert(out.end(), payload.begin(), payload.end());
+}
+
+EditJournal::Edit EditJournal::decode(const uint8_t* payload)
+{
+	std::array<uint32_t, 4> fields{};
+	std::memcpy(fields.data(), payload + 1, sizeof(fields));
+
+	Edit edit;
+	edit.type = static_cast<Edit::Type>(payload[0]);
+	edit.id = BlockId(fields[0]);
+	for (int i = 0; i < 3; i++) {
+		if (edit.type == Edit::Type::SetBlock) {
+			edit.cell[i] = std::bit_cast<int32_t>(fields[i + 1]);
+		} else {
+			edit.pos[i] = std::bit_cast<float>(fields[i + 1]);
+		}
+	}
+	return edit;
+}
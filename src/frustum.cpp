@@ -0,0 +1,49 @@
+#include "frustum.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/geometric.hpp"
+
+#include <array>
+
+Frustum::Frustum(const glm::mat4& view_projection) noexcept
+{
+	// planes are sums and differences of the matrix rows, glm is column major
+	std::array<glm::vec4, 4> rows;
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // left
+	planes[1] = rows[3] - rows[0]; // right
+	planes[2] = rows[3] + rows[1]; // bottom
+	planes[3] = rows[3] - rows[1]; // top
+	planes[4] = rows[3] + rows[2]; // near
+	planes[5] = rows[3] - rows[2]; // far
+
+	for (glm::vec4& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+const std::array<glm::vec4, 6>& Frustum::getPlanes() const
+{
+	return planes;
+}
+
+bool Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (const glm::vec4& plane : planes) {
+		// the corner furthest along the plane normal, if it's outside the whole box is
+		const glm::vec3 corner(
+			(plane.x >= 0.0f) ? max.x : min.x,
+			(plane.y >= 0.0f) ? max.y : min.y,
+			(plane.z >= 0.0f) ? max.z : min.z);
+		if ((glm::dot(glm::vec3(plane), corner) + plane.w) < 0.0f) {
+			return false;
+		}
+	}
+
+	return true;
+}
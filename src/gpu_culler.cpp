@@ -0,0 +1,239 @@
+#include "gpu_culler.h"
+
+#include "shader.h"
+#include "frustum.h"
+#include "instance.h"
+#include "instance_buffer.h"
+#include "component.h"
+#include "mesh.h"
+#include "world.h"
+#include "utils.h"
+
+#include "glad/gl.h"
+#include "glm/vec4.hpp"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+
+// the compute shader copies instances a word at a time
+static_assert((sizeof(Instance) % sizeof(GLuint)) == 0);
+
+GpuCuller::GpuCuller() :
+	shader(cull_shader_path)
+{
+	if (!shader.compile()) {
+		throw std::runtime_error("failed to compile cull shader");
+	}
+
+	glCreateBuffers(1, &command_buffer);
+	glNamedBufferData(command_buffer, BlockId::NumNames * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+	glCreateBuffers(1, &culled_buffer);
+	// an empty buffer object causes errors when binding to a VAO
+	reserve(1);
+
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
+	uploadGeometry();
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	// same layout as Mesh
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)offsetof(Mesh::Vertex, Normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)offsetof(Mesh::Vertex, TexCoords));
+	// base_instance selects the BlockId's range of the culled instances
+	glBindBuffer(GL_ARRAY_BUFFER, culled_buffer);
+	Instance::setupAttribs(instance_vertex_attrib_index);
+	glBindVertexArray(0);
+}
+
+GpuCuller::~GpuCuller()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	glDeleteTextures(1, &diffuse_array);
+	glDeleteTextures(1, &specular_array);
+	glDeleteBuffers(1, &culled_buffer);
+	glDeleteBuffers(1, &command_buffer);
+}
+
+void GpuCuller::setBlockMesh(const BlockId id, const std::vector<Mesh::Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Mesh::Texture>& textures)
+{
+	block_vertices[id.uint()] = vertices;
+	block_indices[id.uint()] = indices;
+	uploadGeometry();
+
+	// first texture of each type, like the material samplers
+	GLuint diffuse = 0;
+	GLuint specular = 0;
+	for (const Mesh::Texture& texture : textures) {
+		if ((texture.type == Mesh::TexType::Diffuse) && (diffuse == 0)) {
+			diffuse = texture.id;
+		} else if ((texture.type == Mesh::TexType::Specular) && (specular == 0)) {
+			specular = texture.id;
+		}
+	}
+	diffuse_textures[id.uint()] = diffuse;
+	specular_textures[id.uint()] = specular;
+	buildTextureArray(diffuse_array, diffuse_textures);
+	buildTextureArray(specular_array, specular_textures);
+}
+
+void GpuCuller::reserve(const size_t count)
+{
+	if (count <= capacity) return;
+
+	// reallocating keeps the buffer name, so attached vertex arrays stay valid
+	capacity = std::max(count, capacity * 2);
+	glNamedBufferData(culled_buffer, BlockId::NumNames * capacity * sizeof(Instance), NULL, GL_DYNAMIC_COPY);
+}
+
+void GpuCuller::cull(const Frustum& frustum, const std::vector<InstanceBuffer>& buffers, const std::vector<std::vector<Instance>>& instances) const
+{
+	// every command starts empty, the compute shader counts the survivors
+	std::array<DrawElementsIndirectCommand, BlockId::NumNames> commands{};
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		commands[i] = DrawElementsIndirectCommand{
+			.count = static_cast<GLuint>(block_indices[i].size()),
+			.instance_count = 0,
+			.first_index = first_indices[i],
+			.base_vertex = base_vertices[i],
+			.base_instance = static_cast<GLuint>(i * capacity)
+		};
+	}
+	glNamedBufferSubData(command_buffer, 0, sizeof(commands), commands.data());
+
+	shader.activate();
+	for (int i = 0; i < 6; i++) {
+		shader.setVec4("frustum_planes[" + std::to_string(i) + "]", frustum.getPlanes()[i]);
+	}
+	shader.setInt("stride_words", sizeof(Instance) / sizeof(GLuint));
+	shader.setBool("packed_instancing", PACKED_INSTANCES);
+	shader.setFloat("half_extent", World::block_half_length);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, culled_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_buffer);
+
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		if (instances[i].empty()) continue;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[i].getId());
+		shader.setInt("instance_count", instances[i].size());
+		shader.setInt("source_first", buffers[i].baseInstance());
+		shader.setInt("bucket", i);
+		glDispatchCompute((instances[i].size() + work_group_size - 1) / work_group_size, 1, 1);
+	}
+
+	// the draws read both the commands and the culled instances
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::draw(const Shader& shader) const
+{
+	shader.setBool("block_texture_arrays", true);
+	glBindTextureUnit(diffuse_texture_unit, diffuse_array);
+	glBindTextureUnit(specular_texture_unit, specular_array);
+
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, BlockId::NumNames, 0);
+	shader.setBool("block_texture_arrays", false);
+}
+
+void GpuCuller::uploadGeometry()
+{
+	size_t num_vertices = 0;
+	size_t num_indices = 0;
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		first_indices[i] = static_cast<GLuint>(num_indices);
+		base_vertices[i] = static_cast<GLint>(num_vertices);
+		num_vertices += block_vertices[i].size();
+		num_indices += block_indices[i].size();
+	}
+
+	std::vector<Mesh::Vertex> vertices;
+	std::vector<unsigned int> indices;
+	vertices.reserve(num_vertices);
+	indices.reserve(num_indices);
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		vertices.insert(vertices.end(), block_vertices[i].begin(), block_vertices[i].end());
+		indices.insert(indices.end(), block_indices[i].begin(), block_indices[i].end());
+	}
+	// never leave a buffer empty, the vertex array still points at it
+	glNamedBufferData(VBO, std::max<size_t>(vertices.size(), 1) * sizeof(Mesh::Vertex), vertices.data(), GL_STATIC_DRAW);
+	glNamedBufferData(EBO, std::max<size_t>(indices.size(), 1) * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+}
+
+void GpuCuller::buildTextureArray(GLuint& array, const std::array<GLuint, BlockId::NumNames>& textures)
+{
+	glDeleteTextures(1, &array);
+	array = 0;
+
+	// the first texture decides the size, format and sampling of every layer
+	const auto first = std::find_if(textures.begin(), textures.end(), [](const GLuint texture) { return texture != 0; });
+	if (first == textures.end()) return;
+
+	GLint width = 0;
+	GLint height = 0;
+	GLint internal_format = 0;
+	glGetTextureLevelParameteriv(*first, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(*first, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(*first, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+	// textures report the unsized format they were created with, storage needs a sized one
+	switch (internal_format)
+	{
+		case GL_RED:
+			internal_format = GL_R8;
+			break;
+		case GL_RGB:
+			internal_format = GL_RGB8;
+			break;
+		case GL_RGBA:
+			internal_format = GL_RGBA8;
+			break;
+		case GL_SRGB:
+			internal_format = GL_SRGB8;
+			break;
+		case GL_SRGB_ALPHA:
+			internal_format = GL_SRGB8_ALPHA8;
+			break;
+		default:
+			break;
+	}
+	const GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(std::max(width, height))));
+
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+	glTextureStorage3D(array, levels, internal_format, width, height, BlockId::NumNames);
+	for (const GLenum param : {GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T}) {
+		GLint value = 0;
+		glGetTextureParameteriv(*first, param, &value);
+		glTextureParameteri(array, param, value);
+	}
+
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		if (textures[i] == 0) continue;
+
+		GLint layer_width = 0;
+		GLint layer_height = 0;
+		glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_WIDTH, &layer_width);
+		glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_HEIGHT, &layer_height);
+		if ((layer_width != width) || (layer_height != height)) {
+			LOG("block texture " << i << " is " << layer_width << "x" << layer_height << ", expected " << width << "x" << height)
+			continue;
+		}
+		// read back instead of glCopyImageSubData, which rejects copies between unsized and sized formats
+		glGetTextureImage(textures[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.size(), pixels.data());
+		glTextureSubImage3D(array, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	}
+	glGenerateTextureMipmap(array);
+}
@@ -0,0 +1,103 @@
+#include "instance.h"
+
+#include "transform_batch.h"
+
+#include "glad/gl.h"
+#include "glm/mat4x4.hpp"
+#include "glm/mat3x3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/ext/matrix_transform.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+PackedInstance PackedInstance::fromPosition(const glm::vec3& position)
+{
+	// converting a float outside the int16 range is undefined, not a wrap
+	return PackedInstance{
+		.x = static_cast<int16_t>(std::clamp(std::floor(position.x), min_cell, max_cell)),
+		.y = static_cast<int16_t>(std::clamp(std::floor(position.y), min_cell, max_cell)),
+		.z = static_cast<int16_t>(std::clamp(std::floor(position.z), min_cell, max_cell))
+	};
+}
+
+bool PackedInstance::inRange(const glm::vec3& position)
+{
+	for (int i = 0; i < 3; i++) {
+		const float cell = std::floor(position[i]);
+		if (!(cell >= min_cell) || !(cell <= max_cell)) return false;
+	}
+	return true;
+}
+
+void PackedInstance::fromPositions(const glm::vec3* positions, PackedInstance* out, const size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		out[i] = fromPosition(positions[i]);
+	}
+}
+
+void PackedInstance::setupAttribs(const GLuint vertex_attrib_index)
+{
+	// converted to floats, the shader rebuilds the model matrix from the cell
+	glEnableVertexAttribArray(vertex_attrib_index);
+	glVertexAttribPointer(vertex_attrib_index, 4, GL_SHORT, GL_FALSE, sizeof(PackedInstance), (void*)0);
+	glVertexAttribDivisor(vertex_attrib_index, 1);
+}
+
+glm::vec3 PackedInstance::position() const
+{
+	// blocks are centered in their cell
+	return glm::vec3(x, y, z) + 0.5f;
+}
+
+MatrixInstance MatrixInstance::fromPosition(const glm::vec3& position)
+{
+	MatrixInstance instance;
+	fromPositions(&position, &instance, 1);
+	return instance;
+}
+
+bool MatrixInstance::inRange(const glm::vec3& position)
+{
+	return true;
+}
+
+void MatrixInstance::fromPositions(const glm::vec3* positions, MatrixInstance* out, const size_t count)
+{
+	std::vector<glm::mat4> models(count);
+	std::vector<glm::mat3> normal_mats(count);
+	for (size_t i = 0; i < count; i++) {
+		models[i] = glm::translate(glm::mat4(1.0f), positions[i]);
+	}
+	transform_batch::normalMatrices(models.data(), normal_mats.data(), count);
+
+	for (size_t i = 0; i < count; i++) {
+		out[i] = MatrixInstance{models[i], normal_mats[i]};
+	}
+}
+
+void MatrixInstance::setupAttribs(const GLuint vertex_attrib_index)
+{
+	GLuint index = vertex_attrib_index;
+	for (int i = 0; i < 4; i++, index++) {
+		glEnableVertexAttribArray(index);
+		glVertexAttribPointer(index, 4, GL_FLOAT, GL_FALSE, sizeof(MatrixInstance), (void*)(offsetof(MatrixInstance, model) + (sizeof(glm::vec4) * i)));
+		glVertexAttribDivisor(index, 1);
+	}
+	for (int i = 0; i < 3; i++, index++) {
+		glEnableVertexAttribArray(index);
+		glVertexAttribPointer(index, 3, GL_FLOAT, GL_FALSE, sizeof(MatrixInstance), (void*)(offsetof(MatrixInstance, normal_mat) + (sizeof(glm::vec3) * i)));
+		glVertexAttribDivisor(index, 1);
+	}
+}
+
+glm::vec3 MatrixInstance::position() const
+{
+	// column 3 of a 4x4 is the translation
+	return glm::vec3(model[3]);
+}
@@ -0,0 +1,237 @@
+#include "instance_buffer.h"
+
+#include "instance.h"
+
+#include "glad/gl.h"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer(const Mode mode) noexcept :
+	mode(mode),
+	fences(ring_segments, nullptr),
+	// nothing is written yet
+	segment_ranges(ring_segments, Range{0, std::numeric_limits<size_t>::max()})
+{
+	// an empty buffer object causes errors when binding to a VAO
+	allocate((mode == Mode::PersistentRing) ? initial_ring_capacity : 1);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	free();
+}
+
+InstanceBuffer::InstanceBuffer(InstanceBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+InstanceBuffer& InstanceBuffer::operator=(InstanceBuffer&& other) noexcept
+{
+	if (this != &other) {
+		free();
+		mode = other.mode;
+		id = std::exchange(other.id, 0);
+		capacity = std::exchange(other.capacity, 0);
+		dirty = std::exchange(other.dirty, {});
+		num_uploads = std::exchange(other.num_uploads, 0);
+		num_stalls = std::exchange(other.num_stalls, 0);
+		mapped = std::exchange(other.mapped, nullptr);
+		segment = std::exchange(other.segment, 0);
+		fences = std::exchange(other.fences, {});
+		segment_ranges = std::exchange(other.segment_ranges, {});
+		attachments = std::exchange(other.attachments, {});
+	}
+	return *this;
+}
+
+GLuint InstanceBuffer::getId() const
+{
+	return id;
+}
+
+InstanceBuffer::Mode InstanceBuffer::getMode() const
+{
+	return mode;
+}
+
+void InstanceBuffer::attach(const GLuint VAO, const GLuint vertex_attrib_index) const
+{
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	Instance::setupAttribs(vertex_attrib_index);
+	attachments.emplace_back(VAO, vertex_attrib_index);
+}
+
+void InstanceBuffer::markDirty(const size_t first, const size_t last)
+{
+	mergeRange(dirty, first, last);
+}
+
+void InstanceBuffer::markAllDirty()
+{
+	markDirty(0, std::numeric_limits<size_t>::max());
+}
+
+bool InstanceBuffer::flush(const std::vector<Instance>& instances)
+{
+	// removals can leave the range past the end of the vector
+	const size_t last = std::min(dirty.last, instances.size());
+	const size_t first = dirty.first;
+	dirty = {};
+	if (first >= last) return false;
+
+	if (mode == Mode::PersistentRing) {
+		// double the segments instead of following the vector, growth stays rare
+		if (instances.size() > capacity) {
+			allocate(std::max(instances.size(), capacity * 2));
+		}
+
+		// every segment misses this flush's changes, the next one gets them and whatever it missed before
+		for (Range& range : segment_ranges) {
+			mergeRange(range, first, last);
+		}
+		const size_t next = (segment + 1) % ring_segments;
+		waitSegment(next);
+		Range& stale = segment_ranges[next];
+		const size_t stale_last = std::min(stale.last, instances.size());
+		if (stale.first < stale_last) {
+			std::memcpy(mapped + (next * capacity) + stale.first, instances.data() + stale.first, (stale_last - stale.first) * sizeof(Instance));
+		}
+		stale = {};
+		segment = next;
+	// resize following std::vector's amortized complexity, the new store needs everything copied
+	} else if (instances.size() > capacity) {
+		capacity = instances.capacity();
+		glNamedBufferData(id, capacity * sizeof(Instance), NULL, GL_DYNAMIC_DRAW);
+		glNamedBufferSubData(id, 0, instances.size() * sizeof(Instance), instances.data());
+	} else {
+		glNamedBufferSubData(id, first * sizeof(Instance), (last - first) * sizeof(Instance), instances.data() + first);
+	}
+	num_uploads++;
+	return true;
+}
+
+void InstanceBuffer::fence()
+{
+	if (mode != Mode::PersistentRing) return;
+
+	if (fences[segment]) {
+		glDeleteSync(fences[segment]);
+	}
+	fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t InstanceBuffer::baseInstance() const
+{
+	return (mode == Mode::PersistentRing) ? (segment * capacity) : 0;
+}
+
+size_t InstanceBuffer::numUploads() const
+{
+	return num_uploads;
+}
+
+size_t InstanceBuffer::numStalls() const
+{
+	return num_stalls;
+}
+
+void InstanceBuffer::mergeRange(Range& range, const size_t first, const size_t last)
+{
+	if (first >= last) return;
+
+	if (range.first >= range.last) {
+		range = Range{first, last};
+	} else {
+		range.first = std::min(range.first, first);
+		range.last = std::max(range.last, last);
+	}
+}
+
+void InstanceBuffer::allocate(const size_t new_capacity)
+{
+	const GLuint old_id = id;
+	const Instance* const old_mapped = mapped;
+	const size_t old_capacity = capacity;
+
+	glCreateBuffers(1, &id);
+	capacity = new_capacity;
+	if (mode == Mode::PersistentRing) {
+		// coherent so writes are visible to the next draw without an explicit flush
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		const GLsizeiptr size_bytes = ring_segments * capacity * sizeof(Instance);
+		glNamedBufferStorage(id, size_bytes, NULL, flags);
+		mapped = static_cast<Instance*>(glMapNamedBufferRange(id, 0, size_bytes, flags));
+		// the new buffer starts at the current segment so draws keep working until the next flush
+		if (old_mapped) {
+			std::memcpy(mapped + (segment * capacity), old_mapped + (segment * old_capacity), old_capacity * sizeof(Instance));
+		}
+		// the other segments start empty
+		for (size_t i = 0; i < segment_ranges.size(); i++) {
+			if (i != segment) {
+				segment_ranges[i] = Range{0, std::numeric_limits<size_t>::max()};
+			}
+		}
+	} else {
+		glNamedBufferData(id, capacity * sizeof(Instance), NULL, GL_DYNAMIC_DRAW);
+	}
+
+	if (old_id != 0) {
+		// the driver keeps the old storage alive until pending draws finish, so its fences aren't needed
+		for (GLsync& sync : fences) {
+			if (sync) {
+				glDeleteSync(sync);
+				sync = nullptr;
+			}
+		}
+		if (old_mapped) {
+			glUnmapNamedBuffer(old_id);
+		}
+		glDeleteBuffers(1, &old_id);
+		for (const auto& [VAO, index] : attachments) {
+			glBindVertexArray(VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, id);
+			Instance::setupAttribs(index);
+		}
+	}
+}
+
+void InstanceBuffer::waitSegment(const size_t index)
+{
+	GLsync& sync = fences[index];
+	if (!sync) return;
+
+	// poll first, only flush commands and block if the gpu is really behind
+	GLenum result = glClientWaitSync(sync, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		num_stalls++;
+		do {
+			result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(sync);
+	sync = nullptr;
+}
+
+void InstanceBuffer::free()
+{
+	for (GLsync& sync : fences) {
+		if (sync) {
+			glDeleteSync(sync);
+			sync = nullptr;
+		}
+	}
+	if (mapped) {
+		glUnmapNamedBuffer(id);
+		mapped = nullptr;
+	}
+	glDeleteBuffers(1, &id);
+	id = 0;
+	capacity = 0;
+}
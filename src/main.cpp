@@ -24,6 +24,9 @@ int main()
 		// input update
 		game_data.screen.processInput(delta_time);
 
+		// world update
+		game_data.world.update(game_data.camera->getPosition());
+
 		// light update
 		game_data.light_block->updateDirection(LightBlock::LightType::Directional, 0, glm::normalize(glm::vec4(game_data.time.getSunXDir(), game_data.time.getSunYDir(), 0.0f, 0.0f)));
 		game_data.light_block->updatePosition(LightBlock::LightType::Spot, 0, glm::vec4(game_data.camera->getPosition(), 1.0f));
@@ -32,7 +35,6 @@ int main()
 		// transform update
 		glm::mat4 projection = glm::perspective(glm::radians(game_data.camera->getZoom()), static_cast<float>(SCR_WIDTH) / SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
 		glm::mat4 view = game_data.camera->getViewMatrix();
-		game_data.world.updateNormalMats(view);
 
 		// shadow render
 		game_data.shadow.renderDepthmap(game_data.camera->getPosition(), game_data.models, game_data.world);
@@ -47,6 +49,8 @@ int main()
 		game_data.default_shader.setMat4("light_view", game_data.shadow.getView());
 		game_data.default_shader.setMat4("light_projection", game_data.shadow.getProjection());
 		renderScene(view, projection, game_data.default_shader, game_data.models, game_data.world);
+		// instance data read by the shadow and world passes stays untouched until the gpu catches up
+		game_data.world.endFrame();
 
 		// light render
 		game_data.light_shader.activate();
@@ -66,6 +70,9 @@ int main()
 		game_data.cube.draw(game_data.skybox_shader);
 		glCullFace(cull_mode);
 
+		// debug window render
+		game_data.screen.drawDebugWindow(game_data.world);
+
 		game_data.screen.endFrame();
 	}
 
@@ -0,0 +1,113 @@
+#include "mapped_file.h"
+
+#include "utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+	bytes(std::exchange(other.bytes, nullptr)),
+	length(std::exchange(other.length, 0))
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other) {
+		close();
+		bytes = std::exchange(other.bytes, nullptr);
+		length = std::exchange(other.length, 0);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size) || (file_size.QuadPart == 0)) {
+		CloseHandle(file);
+		return false;
+	}
+	const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	// the view keeps the file open, neither handle is needed once it exists
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if (!view) {
+		LOG("Unable to map " << path)
+		return false;
+	}
+	length = static_cast<size_t>(file_size.QuadPart);
+#else
+	const int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat file_stat{};
+	if ((fstat(file, &file_stat) != 0) || (file_stat.st_size == 0)) {
+		::close(file);
+		return false;
+	}
+	// the mapping keeps the file open, the descriptor isn't needed once it exists
+	void* const view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (view == MAP_FAILED) {
+		LOG("Unable to map " << path)
+		return false;
+	}
+	length = static_cast<size_t>(file_stat.st_size);
+#endif
+
+	bytes = static_cast<const uint8_t*>(view);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!bytes) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(bytes);
+#else
+	munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return bytes != nullptr;
+}
+
+const uint8_t* MappedFile::data() const
+{
+	return bytes;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
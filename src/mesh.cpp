@@ -51,9 +51,21 @@ Mesh& Mesh::operator=(Mesh&& other) noexcept
     return *this;
 }
 
-void Mesh::draw(const Shader& shader, const unsigned int num) const
+void Mesh::draw(const Shader& shader, const unsigned int num, const unsigned int base_instance) const
+{
+    bindTextures(shader);
+
+    // draw
+    glBindVertexArray(VAO);
+    if (num == 0) {
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    } else {
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, num, base_instance);
+    }
+}
+
+void Mesh::bindTextures(const Shader& shader) const
 {
-    // textures
     if (textures.size() > GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS) {
         LOG("unable to use all textures, exceeded max texture units")
     }
@@ -68,19 +80,11 @@ void Mesh::draw(const Shader& shader, const unsigned int num) const
         glActiveTexture(GL_TEXTURE0 + i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
-
-    // draw
-    glBindVertexArray(VAO);
-    if (num == 0) {
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    } else {
-        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, num);
-    }
 }
 
 void Mesh::setupInstancing(const World& world, const BlockId id) const
 {
-    world.setupInstancing(VAO, instance_vertex_attrib_index, id);
+    world.setupInstancing(VAO, instance_vertex_attrib_index, id, vertices, indices, textures);
 }
 
 std::string Mesh::texTypeToString(const TexType type) const
@@ -23,10 +23,10 @@ Model::Model(const std::string& path, BlockId id) noexcept : id(id)
 	loadModel(path);
 }
 
-void Model::draw(const Shader& shader, const unsigned int num) const
+void Model::draw(const Shader& shader, const unsigned int num, const unsigned int base_instance) const
 {
     for (const Mesh& mesh : meshes) {
-        mesh.draw(shader, num);
+        mesh.draw(shader, num, base_instance);
     }
 }
 
@@ -42,6 +42,14 @@ void Model::setupInstancing(const World& world) const
     }
 }
 
+void Model::bindTextures(const Shader& shader) const
+{
+    // block models are a single mesh
+    if (!meshes.empty()) {
+        meshes.front().bindTextures(shader);
+    }
+}
+
 void Model::loadModel(const std::string& path)
 {
     Assimp::Importer import;
@@ -0,0 +1,177 @@
+#include "occlusion_buffer.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/common.hpp"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+// OCCLUSION_BUFFER_SCALAR leaves only the scalar loops, the tests build it so both paths are covered
+#if defined(__SSE2__) && !defined(OCCLUSION_BUFFER_SCALAR)
+#define OCCLUSION_BUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// the twelve triangles of a box, corner bit 0 is x, bit 1 is y, bit 2 is z
+	constexpr std::array<std::array<int, 3>, 12> box_triangles = {{
+		{0, 1, 3}, {0, 3, 2}, // -z
+		{4, 6, 7}, {4, 7, 5}, // +z
+		{0, 4, 5}, {0, 5, 1}, // -y
+		{2, 3, 7}, {2, 7, 6}, // +y
+		{0, 2, 6}, {0, 6, 4}, // -x
+		{1, 5, 7}, {1, 7, 3}, // +x
+	}};
+	// pixels handled per step, matches the simd width
+	constexpr int lanes = 4;
+}
+
+OcclusionBuffer::OcclusionBuffer(const int width, const int height) noexcept :
+	width((width + lanes - 1) / lanes * lanes),
+	height(height),
+	depth(this->width * height, 1.0f)
+{}
+
+void OcclusionBuffer::begin(const glm::mat4& view_projection)
+{
+	this->view_projection = view_projection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+bool OcclusionBuffer::addOccluder(const glm::vec3& min, const glm::vec3& max)
+{
+	Corners corners;
+	if (!project(min, max, corners)) return false;
+
+	for (const std::array<int, 3>& triangle : box_triangles) {
+		rasterizeTriangle(corners[triangle[0]], corners[triangle[1]], corners[triangle[2]]);
+	}
+	return true;
+}
+
+bool OcclusionBuffer::isVisible(const glm::vec3& min, const glm::vec3& max) const
+{
+	Corners corners;
+	if (!project(min, max, corners)) return true;
+
+	glm::vec3 screen_min = corners[0];
+	glm::vec3 screen_max = corners[0];
+	for (const glm::vec3& corner : corners) {
+		screen_min = glm::min(screen_min, corner);
+		screen_max = glm::max(screen_max, corner);
+	}
+
+	// every pixel the box could touch, the nearest corner stands in for the whole box
+	const int x0 = std::max(static_cast<int>(std::floor(screen_min.x)), 0);
+	const int y0 = std::max(static_cast<int>(std::floor(screen_min.y)), 0);
+	const int x1 = std::min(static_cast<int>(std::ceil(screen_max.x)), width);
+	const int y1 = std::min(static_cast<int>(std::ceil(screen_max.y)), height);
+	if ((x0 >= x1) || (y0 >= y1)) return true;
+	const float box_depth = screen_min.z;
+
+	for (int y = y0; y < y1; y++) {
+		const float* const row = depth.data() + (y * width);
+		int x = x0;
+#if defined(OCCLUSION_BUFFER_SSE2)
+		const __m128 box_depths = _mm_set1_ps(box_depth);
+		for (; (x + lanes) <= x1; x += lanes) {
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), box_depths)) != 0) {
+				return true;
+			}
+		}
+#endif
+		for (; x < x1; x++) {
+			if (row[x] >= box_depth) return true;
+		}
+	}
+
+	return false;
+}
+
+bool OcclusionBuffer::project(const glm::vec3& min, const glm::vec3& max, Corners& corners) const
+{
+	for (int i = 0; i < 8; i++) {
+		const glm::vec4 corner(
+			(i & 1) ? max.x : min.x,
+			(i & 2) ? max.y : min.y,
+			(i & 4) ? max.z : min.z,
+			1.0f);
+		const glm::vec4 clip = view_projection * corner;
+		// perspective division isn't meaningful in front of the near plane
+		if ((clip.w <= 0.0f) || (clip.z < -clip.w)) return false;
+
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		corners[i] = glm::vec3(
+			((ndc.x * 0.5f) + 0.5f) * width,
+			((0.5f - (ndc.y * 0.5f))) * height,
+			ndc.z);
+	}
+	return true;
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	// twice the signed area, skip degenerate triangles and flip so both windings count as inside
+	float area = ((b.x - a.x) * (c.y - a.y)) - ((b.y - a.y) * (c.x - a.x));
+	if (std::abs(area) < 1e-6f) return;
+	const float sign = (area > 0.0f) ? 1.0f : -1.0f;
+	area *= sign;
+
+	// every edge, depth included, is a plane in screen space: value = (dx * x) + (dy * y) + offset
+	struct Plane {
+		float dx;
+		float dy;
+		float offset;
+	};
+	const auto edge = [sign](const glm::vec3& from, const glm::vec3& to) {
+		const float dx = -(to.y - from.y) * sign;
+		const float dy = (to.x - from.x) * sign;
+		return Plane{dx, dy, -((dx * from.x) + (dy * from.y))};
+	};
+	const std::array<Plane, 3> edges = {edge(b, c), edge(c, a), edge(a, b)};
+	// barycentric weights are the edge values over the area, so depth is a plane too
+	const float depth_dx = ((edges[0].dx * a.z) + (edges[1].dx * b.z) + (edges[2].dx * c.z)) / area;
+	const float depth_dy = ((edges[0].dy * a.z) + (edges[1].dy * b.z) + (edges[2].dy * c.z)) / area;
+	const float depth_offset = ((edges[0].offset * a.z) + (edges[1].offset * b.z) + (edges[2].offset * c.z)) / area;
+
+	const int x0 = std::max(static_cast<int>(std::floor(std::min({a.x, b.x, c.x}))), 0) / lanes * lanes;
+	const int y0 = std::max(static_cast<int>(std::floor(std::min({a.y, b.y, c.y}))), 0);
+	const int x1 = std::min(static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}))), width);
+	const int y1 = std::min(static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}))), height);
+
+	for (int y = y0; y < y1; y++) {
+		float* const row = depth.data() + (y * width);
+		const float py = y + 0.5f;
+		int x = x0;
+#if defined(OCCLUSION_BUFFER_SSE2)
+		// x0 is lane aligned and width a multiple of lanes, so whole steps never leave the row
+		const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		for (; x < x1; x += lanes) {
+			const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offsets);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (const Plane& plane : edges) {
+				const __m128 value = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.dx)), _mm_set1_ps((plane.dy * py) + plane.offset));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(value, _mm_setzero_ps()));
+			}
+			const __m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(depth_dx)), _mm_set1_ps((depth_dy * py) + depth_offset));
+			const __m128 old_z = _mm_loadu_ps(row + x);
+			const __m128 nearest = _mm_min_ps(old_z, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old_z)));
+		}
+#endif
+		for (; x < x1; x++) {
+			const float px = x + 0.5f;
+			bool inside = true;
+			for (const Plane& plane : edges) {
+				inside &= (((plane.dx * px) + (plane.dy * py) + plane.offset) >= 0.0f);
+			}
+			if (inside) {
+				row[x] = std::min(row[x], (depth_dx * px) + (depth_dy * py) + depth_offset);
+			}
+		}
+	}
+}
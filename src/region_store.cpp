@@ -0,0 +1,304 @@
+#include "region_store.h"
+
+#include "chunk.h"
+#include "utils.h"
+#include "mapped_file.h"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <tuple>
+#include <cstring>
+#include <limits>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+#include <cstddef>
+
+RegionStore::RegionStore(const std::string& directory) noexcept :
+	directory(directory)
+{}
+
+void RegionStore::load(const std::vector<ChunkCoord>& coords, std::vector<Chunk>& chunks, std::vector<uint8_t>& found) const
+{
+	chunks.assign(coords.size(), Chunk());
+	found.assign(coords.size(), 0);
+	const std::lock_guard<std::mutex> lock(mutex);
+
+	// mapping happens here, the workers below only read from mappings that already exist
+	std::vector<const Region*> chunk_regions(coords.size(), nullptr);
+	for (size_t i = 0; i < coords.size(); i++) {
+		const Region& region = openRegion(regionOf(coords[i]));
+		chunk_regions[i] = region.valid ? &region : nullptr;
+	}
+
+	// checksums and decoding touch the record pages, so page faults are spread across every core too
+	utils::parallelFor(coords.size(), [&](const size_t i) {
+		if (!chunk_regions[i]) return;
+
+		const Entry& entry = chunk_regions[i]->table[entryIndex(coords[i])];
+		const uint8_t* record = nullptr;
+		found[i] = findRecord(*chunk_regions[i], entry, record) && chunks[i].decode(record, entry.size);
+	});
+}
+
+bool RegionStore::save(const ChunkRefs& chunks, size_t& bytes_written) const
+{
+	bytes_written = 0;
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) {
+		LOG("Unable to create region directory " << directory)
+		return false;
+	}
+
+	std::unordered_map<ChunkCoord, std::vector<size_t>> region_chunks;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		region_chunks[regionOf(chunks[i].first)].push_back(i);
+	}
+
+	bool success = true;
+	for (const auto& [region, indices] : region_chunks) {
+		std::vector<std::vector<uint8_t>> records(std::tuple_size_v<Table>);
+		std::vector<uint8_t> present(records.size(), 0);
+		size_t new_bytes = 0;
+		for (const size_t i : indices) {
+			const size_t index = entryIndex(chunks[i].first);
+			chunks[i].second->encode(records[index]);
+			present[index] = 1;
+			new_bytes += records[index].size();
+		}
+
+		size_t region_bytes = 0;
+		if (appendRegion(region, records, present, new_bytes, region_bytes) || rewriteRegion(region, records, present, region_bytes)) {
+			bytes_written += region_bytes;
+		} else {
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+bool RegionStore::appendRegion(const ChunkCoord& region, const std::vector<std::vector<uint8_t>>& records,
+	const std::vector<uint8_t>& present, const size_t new_bytes, size_t& bytes_written) const
+{
+	// only held to read the table and to patch the head, records and the tail table land past what the
+	// old head points at so loads can map the file while they are written and synced
+	// saves come from one thread, the table can't change while the lock is released
+	std::unique_lock<std::mutex> lock(mutex);
+	const Region& old_region = openRegion(region);
+	if (!old_region.valid) return false;
+
+	// records that are replaced stay in the file as garbage, compact once it outweighs the live records
+	size_t live_bytes = new_bytes;
+	for (size_t i = 0; i < records.size(); i++) {
+		if (!present[i]) {
+			live_bytes += old_region.table[i].size;
+		}
+	}
+	// old table copies at the end of earlier appends count as garbage too
+	const size_t file_size = old_region.file.size();
+	const size_t new_file_size = file_size + new_bytes + sizeof(Header) + sizeof(Table);
+	const size_t garbage_bytes = new_file_size - (2 * (sizeof(Header) + sizeof(Table))) - live_bytes;
+	// a few table copies of slack so regions with little in them aren't rewritten every other save
+	if ((garbage_bytes > (live_bytes + (4 * sizeof(Table)))) || (new_file_size > std::numeric_limits<uint32_t>::max())) return false;
+
+	Table table = old_region.table;
+	// the mapping has to go before the file grows, it is mapped again on the next read
+	regions.erase(region);
+	lock.unlock();
+
+	std::fstream stream(regionPath(region), std::ios::in | std::ios::out | std::ios::binary);
+	stream.seekp(0, std::ios::end);
+	uint32_t offset = static_cast<uint32_t>(file_size);
+	for (size_t i = 0; i < records.size(); i++) {
+		if (!present[i]) continue;
+
+		const uint32_t size = static_cast<uint32_t>(records[i].size());
+		stream.write(reinterpret_cast<const char*>(records[i].data()), size);
+		table[i] = Entry{offset, size, utils::crc32(records[i].data(), size)};
+		offset += size;
+	}
+	Header header{magic, version, utils::crc32(table.data(), sizeof(Table)), 0};
+	for (const Entry& entry : table) {
+		header.num_records += (entry.size > 0);
+	}
+	// a copy of the new table ends the file, a crash while the head is patched falls back to it
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	stream.write(reinterpret_cast<const char*>(table.data()), sizeof(Table));
+	// the head is patched last so it only points at records that are fully written
+	stream.flush();
+	if (!stream || !utils::syncFile(regionPath(region))) {
+		LOG("Unable to append to region file " << regionPath(region))
+		return false;
+	}
+
+	// a load that mapped the file while it grew still holds the old table, drop it with the head patched
+	lock.lock();
+	stream.seekp(0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	stream.write(reinterpret_cast<const char*>(table.data()), sizeof(Table));
+	stream.flush();
+	regions.erase(region);
+	lock.unlock();
+	if (!stream || !utils::syncFile(regionPath(region))) {
+		LOG("Unable to append to region file " << regionPath(region))
+		return false;
+	}
+
+	bytes_written = new_bytes + (2 * (sizeof(Header) + sizeof(Table)));
+	return true;
+}
+
+bool RegionStore::rewriteRegion(const ChunkCoord& region, std::vector<std::vector<uint8_t>>& records,
+	std::vector<uint8_t>& present, size_t& bytes_written) const
+{
+	const std::string path = regionPath(region);
+	// chunks saved earlier that aren't part of this save keep their old records
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		const Region& old_region = openRegion(region);
+		for (size_t i = 0; old_region.valid && (i < records.size()); i++) {
+			const uint8_t* old_record = nullptr;
+			if (!present[i] && findRecord(old_region, old_region.table[i], old_record)) {
+				records[i].assign(old_record, old_record + old_region.table[i].size);
+				present[i] = 1;
+			}
+		}
+	}
+
+	Header header{magic, version, 0, 0};
+	Table table{};
+	uint32_t offset = sizeof(Header) + sizeof(Table);
+	for (size_t i = 0; i < records.size(); i++) {
+		if (!present[i]) continue;
+
+		const uint32_t size = static_cast<uint32_t>(records[i].size());
+		table[i] = Entry{offset, size, utils::crc32(records[i].data(), records[i].size())};
+		offset += size;
+		header.num_records++;
+	}
+	header.table_crc = utils::crc32(table.data(), sizeof(Table));
+
+	// write next to the old file and swap it in, a failed save leaves the old region intact
+	const std::string temp_path = path + ".tmp";
+	{
+		std::ofstream stream(temp_path, std::ios::out | std::ios::trunc | std::ios::binary);
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		stream.write(reinterpret_cast<const char*>(table.data()), sizeof(Table));
+		for (size_t i = 0; i < records.size(); i++) {
+			if (present[i]) {
+				stream.write(reinterpret_cast<const char*>(records[i].data()), records[i].size());
+			}
+		}
+		stream.flush();
+		if (!stream || !utils::syncFile(temp_path)) {
+			LOG("Unable to write region file " << temp_path)
+			return false;
+		}
+	}
+
+	// the mapping has to go before the file is replaced, it is mapped again on the next read
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		regions.erase(region);
+		std::error_code error;
+		std::filesystem::rename(temp_path, path, error);
+		if (error) {
+			LOG("Unable to replace region file " << path)
+			return false;
+		}
+	}
+	// until the directory is synced a power loss can undo the rename, outside the lock since readers don't need it
+	if (!utils::syncDirectory(directory)) return false;
+
+	bytes_written = offset;
+	return true;
+}
+
+void RegionStore::clear() const
+{
+	close();
+	const std::lock_guard<std::mutex> lock(mutex);
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
+
+void RegionStore::close() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	regions.clear();
+}
+
+ChunkCoord RegionStore::regionOf(const ChunkCoord& coord)
+{
+	// round toward negative infinity so regions don't straddle the origin
+	auto floor_div = [](const int value) {
+		return ((value >= 0) ? value : (value - (region_size - 1))) / region_size;
+	};
+	return ChunkCoord{floor_div(coord.x), floor_div(coord.z)};
+}
+
+std::string RegionStore::regionPath(const ChunkCoord& region) const
+{
+	return directory + "/r." + std::to_string(region.x) + "." + std::to_string(region.z) + ".bin";
+}
+
+const RegionStore::Region& RegionStore::openRegion(const ChunkCoord& coord) const
+{
+	const auto [it, inserted] = regions.try_emplace(coord);
+	Region& region = it->second;
+	if (!inserted) return region;
+
+	if (!region.file.open(regionPath(coord)) || (region.file.size() < (sizeof(Header) + sizeof(Table)))) return region;
+
+	// copied out of the mapping so the fields are aligned, records are the only part read in place
+	auto read_table = [&region](const size_t offset) {
+		Header header;
+		std::memcpy(&header, region.file.data() + offset, sizeof(Header));
+		if ((header.magic != magic) || (header.version != version)) return false;
+
+		std::memcpy(region.table.data(), region.file.data() + offset + sizeof(Header), sizeof(Table));
+		return utils::crc32(region.table.data(), sizeof(Table)) == header.table_crc;
+	};
+	// an append that crashed while patching the head left its table at the end of the file
+	const size_t tail_offset = region.file.size() - (sizeof(Header) + sizeof(Table));
+	if (!read_table(0) && ((tail_offset == 0) || !read_table(tail_offset))) {
+		LOG("Region offset table is corrupt")
+		region.table = {};
+		return region;
+	}
+
+	region.valid = true;
+	return region;
+}
+
+bool RegionStore::findRecord(const Region& region, const Entry& entry, const uint8_t*& data)
+{
+	if (entry.size == 0) return false;
+
+	if ((static_cast<size_t>(entry.offset) + entry.size) > region.file.size()) {
+		LOG("Region chunk record is out of bounds")
+		return false;
+	}
+	data = region.file.data() + entry.offset;
+	if (utils::crc32(data, entry.size) != entry.crc) {
+		LOG("Region chunk record is corrupt")
+		return false;
+	}
+
+	return true;
+}
+
+size_t RegionStore::entryIndex(const ChunkCoord& coord)
+{
+	const ChunkCoord region = regionOf(coord);
+	const int x = coord.x - (region.x * region_size);
+	const int z = coord.z - (region.z * region_size);
+	return static_cast<size_t>((x * region_size) + z);
+}
@@ -2,6 +2,8 @@
 
 #include "utils.h"
 #include "camera.h"
+#include "world.h"
+#include "chunk_mesher.h"
 #include "constants.h"
 
 #include "glfw.h"
@@ -23,13 +25,24 @@ ScreenManager::ScreenManager(const std::shared_ptr<Camera>& camera) : camera(cam
 	if (!initOpenGL()) {
 		throw std::runtime_error("Failed to construct ScreenManager");
 	}
+	imguiInit(window);
+	imgui_initialized = true;
+}
+
+ScreenManager::~ScreenManager()
+{
+	if (imgui_initialized) {
+		imguiShutdown();
+	}
 }
 
 ScreenManager::ScreenManager(ScreenManager&& other) noexcept :
 	window(other.window),
+	imgui_initialized(other.imgui_initialized),
 	camera{std::move(other.camera)}
 {
 	other.glfw_deleter.removeDeleter();
+	other.imgui_initialized = false;
 }
 
 GLFWwindow* const ScreenManager::getWindow()
@@ -43,6 +56,12 @@ void ScreenManager::processInput(const float delta_time)
 	processGamepadInput(delta_time);
 }
 
+void ScreenManager::drawDebugWindow(World& world)
+{
+	imguiStartFrame(world);
+	imguiEndFrame();
+}
+
 void ScreenManager::endFrame()
 {
 	glfwSwapBuffers(window);
@@ -215,7 +234,7 @@ void ScreenManager::processGamepadInput(const float delta_time)
 	}
 }
 
-void ScreenManager::imguiStartFrame(LightBlock& light_block, bool* p_open)
+void ScreenManager::imguiStartFrame(World& world, bool* p_open)
 {
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
@@ -223,16 +242,55 @@ void ScreenManager::imguiStartFrame(LightBlock& light_block, bool* p_open)
 
     const ImGuiViewport* main_viewport = ImGui::GetMainViewport();
     ImGui::SetNextWindowPos(ImVec2(main_viewport->WorkPos.x + 10, main_viewport->WorkPos.y + 10), ImGuiCond_FirstUseEver);
-    ImGui::SetNextWindowSize(ImVec2(SCR_WIDTH, SCR_HEIGHT), ImGuiCond_FirstUseEver);
 
-    // Main body of the Demo window starts here.
-    if (!ImGui::Begin("Dear ImGui", p_open, 0))
+    if (!ImGui::Begin("World", p_open, ImGuiWindowFlags_AlwaysAutoResize))
     {
         // Early out if the window is collapsed, as an optimization.
         ImGui::End();
         return;
     }
 
+	ImGui::Text("Chunks: %zu", world.numChunks());
+	// switching remeshes every loaded chunk, so both modes can be compared on the same terrain
+	int meshing_mode = static_cast<int>(world.getMeshingMode());
+	if (ImGui::Combo("Meshing", &meshing_mode, "Culled\0Greedy\0")) {
+		world.setMeshingMode(static_cast<ChunkMesher::Mode>(meshing_mode));
+	}
+	ImGui::Text("Terrain vertices: %zu", world.numTerrainVertices());
+	ImGui::Text("Terrain triangles: %zu", world.numTerrainTriangles());
+
+	// summed over the shadow and camera passes of the last frame
+	const World::CullStats& cull_stats = world.getCullStats();
+	ImGui::Separator();
+	// stays on cpu culling if the cull shader didn't build
+	bool gpu_culling = (world.getCullingMode() == World::CullingMode::Gpu);
+	if (ImGui::Checkbox("GPU instance culling", &gpu_culling)) {
+		world.setCullingMode(gpu_culling ? World::CullingMode::Gpu : World::CullingMode::Cpu);
+	}
+	ImGui::Text("Chunks drawn: %zu", cull_stats.chunks_drawn);
+	ImGui::Text("Chunks frustum culled: %zu", cull_stats.chunks_culled);
+	ImGui::Text("Instance buckets culled: %zu", cull_stats.instance_buckets_culled);
+
+	ImGui::Separator();
+	bool occlusion_culling = world.getOcclusionCulling();
+	if (ImGui::Checkbox("Occlusion culling", &occlusion_culling)) {
+		world.setOcclusionCulling(occlusion_culling);
+	}
+	ImGui::Text("Chunks occlusion tested: %zu", cull_stats.chunks_occlusion_tested);
+	ImGui::Text("Chunks occluded: %zu", cull_stats.chunks_occluded);
+	ImGui::Text("Occluders rasterized: %zu", cull_stats.occluders_rasterized);
+
+	// counted since the world was created
+	const ChunkCache::Stats& cache_stats = world.getChunkCacheStats();
+	const auto cache_tier = [](const char* name, const ChunkCache::TierStats& tier) {
+		ImGui::Text("%s: %zu hits, %zu misses, %zu evictions", name, tier.hits, tier.misses, tier.evictions);
+		ImGui::Text("  %zu entries, %.1f MiB", tier.entries, static_cast<double>(tier.bytes) / (1 << 20));
+	};
+	ImGui::Separator();
+	cache_tier("Cached voxels", cache_stats.voxels);
+	cache_tier("Cached mesh data", cache_stats.mesh_data);
+	cache_tier("Cached gpu meshes", cache_stats.gpu_meshes);
+
     ImGui::End();
 }
 
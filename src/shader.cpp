@@ -29,6 +29,11 @@ Shader::Shader(const std::string& vertex_path, const std::string& fragment_path,
 	setShaderCode(vertex_path, fragment_path, geometry_path);
 }
 
+Shader::Shader(const std::string& compute_path)
+{
+	setShaderCode(ProgramType::Compute, compute_path);
+}
+
 Shader::~Shader() {
 	resetProgram();
 }
@@ -38,14 +43,17 @@ Shader::Shader(Shader&& other) noexcept :
 	vertex_num_injected{other.vertex_num_injected},
 	fragment_num_injected{other.fragment_num_injected},
 	geometry_num_injected{other.geometry_num_injected},
+	compute_num_injected{other.compute_num_injected},
 	light_block{std::move(other.light_block)},
 	lit_programs{std::move(other.lit_programs)},
 	vertex_code{std::move(other.vertex_code)},
 	fragment_code{std::move(other.fragment_code)},
 	geometry_code{std::move(other.geometry_code)},
+	compute_code{std::move(other.compute_code)},
 	vertex_path{std::move(other.vertex_path)},
 	fragment_path{std::move(other.fragment_path)},
-	geometry_path{std::move(other.geometry_path)}
+	geometry_path{std::move(other.geometry_path)},
+	compute_path{std::move(other.compute_path)}
 {}
 
 unsigned int Shader::getId() const
@@ -98,6 +106,11 @@ bool Shader::setShaderCode(const ProgramType type, const std::string& code_path_
 			code_path = &geometry_path;
 			num_injected_lines = &geometry_num_injected;
 			break;
+		case ProgramType::Compute:
+			code = &compute_code;
+			code_path = &compute_path;
+			num_injected_lines = &compute_num_injected;
+			break;
 		default:
 			LOG("Attempted to set invalid shader code type")
 			return false;
@@ -138,6 +151,11 @@ void Shader::resetShaderCode(const ProgramType type)
 			code = &geometry_path;
 			num_injected_lines = &geometry_num_injected;
 			break;
+		case ProgramType::Compute:
+			code = &compute_code;
+			code_path = &compute_path;
+			num_injected_lines = &compute_num_injected;
+			break;
 		default:
 			LOG("Cannot reset shader code, Invalid shader type")
 			return;
@@ -220,10 +238,14 @@ bool Shader::compile()
 	bool success = true;
 
 	id = glCreateProgram();
-	success &= compileAndAttach(vertex_code, ProgramType::Vertex);
-	success &= compileAndAttach(fragment_code, ProgramType::Fragment);
-	if (!geometry_code.empty()) {
-		success &= compileAndAttach(geometry_code, ProgramType::Geometry);
+	if (!compute_code.empty()) {
+		success &= compileAndAttach(compute_code, ProgramType::Compute);
+	} else {
+		success &= compileAndAttach(vertex_code, ProgramType::Vertex);
+		success &= compileAndAttach(fragment_code, ProgramType::Fragment);
+		if (!geometry_code.empty()) {
+			success &= compileAndAttach(geometry_code, ProgramType::Geometry);
+		}
 	}
 
 	glLinkProgram(id);
@@ -330,6 +352,8 @@ bool Shader::compileAndAttach(const std::string& code, const ProgramType type) c
 			shader_id = glCreateShader(GL_FRAGMENT_SHADER); break;
 		case ProgramType::Geometry:
 			shader_id = glCreateShader(GL_GEOMETRY_SHADER); break;
+		case ProgramType::Compute:
+			shader_id = glCreateShader(GL_COMPUTE_SHADER); break;
 		default:
 			LOG("Shader program not recognized")
 			return false;
@@ -353,6 +377,8 @@ std::string Shader::programTypeToString(const ProgramType type) const {
 			return std::string("Fragment"); break;
 		case ProgramType::Geometry:
 			return std::string("Geometry"); break;
+		case ProgramType::Compute:
+			return std::string("Compute"); break;
 		case ProgramType::Linker:
 			return std::string("Linker"); break;
 		default:
@@ -378,6 +404,8 @@ bool Shader::checkCompileErrors(const GLuint shader, const ProgramType type) con
 					code_path = &fragment_path; break;
 				case ProgramType::Geometry:
 					code_path = &geometry_path; break;
+				case ProgramType::Compute:
+					code_path = &compute_path; break;
 				default:
 					LOG("Failed to get debug path data, invalid program type")
 			}
@@ -403,6 +431,7 @@ bool Shader::updateLineNumbers(char* log, const size_t max_size, const ProgramTy
 		case ProgramType::Vertex: num_injected_lines = vertex_num_injected; break;
 		case ProgramType::Fragment: num_injected_lines = fragment_num_injected; break;
 		case ProgramType::Geometry: num_injected_lines = geometry_num_injected; break;
+		case ProgramType::Compute: num_injected_lines = compute_num_injected; break;
 		default:
 			LOG("Unable to update log line numbers, program type invalid")
 			return false;
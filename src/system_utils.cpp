@@ -3,6 +3,8 @@
 #include "screen_manager.h"
 #include "camera.h"
 #include "world.h"
+#include "gpu_culler.h"
+#include "instance.h"
 #include "model.h"
 #include "light_block.h"
 #include "shader.h"
@@ -157,13 +159,35 @@ GLuint loadCubemap(const std::vector<std::string>& faces)
 
 void renderScene(const glm::mat4& view, const glm::mat4& projection, const Shader& shader, const std::vector<Model>& models, const World& world)
 {
+	// only submit what this pass's camera can see, gpu culling binds its own program so it goes first
+	world.cull(projection * view);
+
 	shader.activate();
 	shader.setMat4("view", view);
 	shader.setMat4("projection", projection);
-	shader.setMat3("light_normal_mat", glm::transpose(glm::inverse(glm::mat3(view))));
+	// instance normal matrices are in world space, this takes them and the lights into view space
+	shader.setMat3("view_normal_mat", glm::transpose(glm::inverse(glm::mat3(view))));
+	shader.setBool("packed_instancing", PACKED_INSTANCES);
+	// array samplers keep their own units even when unused, sharing one with a sampler2D fails every draw
+	shader.setInt("block_diffuse", GpuCuller::diffuse_texture_unit);
+	shader.setInt("block_specular", GpuCuller::specular_texture_unit);
+
+	// every instanced block in one draw, the models then only texture the terrain
+	const bool gpu_culling = (world.getCullingMode() == World::CullingMode::Gpu);
+	if (gpu_culling) {
+		shader.setBool("atlas_tiling", false);
+		world.drawInstancesIndirect(shader);
+	}
 
 	for (const auto& model : models) {
-		model.draw(shader, world.numObjects(model.id));
+		// dynamic blocks are instanced, a zero count would draw a single uninstanced model
+		if (!gpu_culling && (world.numVisibleObjects(model.id) > 0)) {
+			shader.setBool("atlas_tiling", false);
+			model.draw(shader, world.numObjects(model.id), world.baseInstance(model.id));
+		}
+		shader.setBool("atlas_tiling", true);
+		model.bindTextures(shader);
+		world.drawChunks(model.id);
 	}
 }
 
@@ -0,0 +1,142 @@
+#include "transform_batch.h"
+
+#include "utils.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/mat3x3.hpp"
+
+#include <cstddef>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// one float per lane, handles the tail of every batch
+	struct ScalarLanes
+	{
+		using Type = float;
+		static constexpr size_t width = 1;
+		static Type load(const float* src) { return *src; }
+		static void store(float* dst, const Type val) { *dst = val; }
+		static Type add(const Type one, const Type two) { return one + two; }
+		static Type sub(const Type one, const Type two) { return one - two; }
+		static Type mul(const Type one, const Type two) { return one * two; }
+		static Type div(const Type one, const Type two) { return one / two; }
+	};
+
+#if defined(__AVX2__)
+	struct SimdLanes
+	{
+		using Type = __m256;
+		static constexpr size_t width = 8;
+		static Type load(const float* src) { return _mm256_load_ps(src); }
+		static void store(float* dst, const Type val) { _mm256_store_ps(dst, val); }
+		static Type add(const Type one, const Type two) { return _mm256_add_ps(one, two); }
+		static Type sub(const Type one, const Type two) { return _mm256_sub_ps(one, two); }
+		static Type mul(const Type one, const Type two) { return _mm256_mul_ps(one, two); }
+		static Type div(const Type one, const Type two) { return _mm256_div_ps(one, two); }
+	};
+#elif defined(__SSE2__)
+	struct SimdLanes
+	{
+		using Type = __m128;
+		static constexpr size_t width = 4;
+		static Type load(const float* src) { return _mm_load_ps(src); }
+		static void store(float* dst, const Type val) { _mm_store_ps(dst, val); }
+		static Type add(const Type one, const Type two) { return _mm_add_ps(one, two); }
+		static Type sub(const Type one, const Type two) { return _mm_sub_ps(one, two); }
+		static Type mul(const Type one, const Type two) { return _mm_mul_ps(one, two); }
+		static Type div(const Type one, const Type two) { return _mm_div_ps(one, two); }
+	};
+#else
+	using SimdLanes = ScalarLanes;
+#endif
+
+	// normal matrices of Lanes::width models at once
+	template <typename Lanes>
+	void normalBlock(const glm::mat4* models, glm::mat3* normal_mats)
+	{
+		using V = typename Lanes::Type;
+		constexpr size_t width = Lanes::width;
+
+		// gather the upper 3x3 of each model into structure of arrays, element [column * 3 + row]
+		alignas(32) float elements[9][width];
+		for (size_t i = 0; i < width; i++) {
+			for (int col = 0; col < 3; col++) {
+				for (int row = 0; row < 3; row++) {
+					elements[(col * 3) + row][i] = models[i][col][row];
+				}
+			}
+		}
+
+		V m[9];
+		for (size_t e = 0; e < 9; e++) {
+			m[e] = Lanes::load(elements[e]);
+		}
+
+		// for an affine transform the inverse transpose of the 3x3 is its cofactor matrix over the determinant,
+		// and each cofactor column is the cross product of the other two columns
+		const auto cross = [](const V* one, const V* two, V* out) {
+			out[0] = Lanes::sub(Lanes::mul(one[1], two[2]), Lanes::mul(one[2], two[1]));
+			out[1] = Lanes::sub(Lanes::mul(one[2], two[0]), Lanes::mul(one[0], two[2]));
+			out[2] = Lanes::sub(Lanes::mul(one[0], two[1]), Lanes::mul(one[1], two[0]));
+		};
+		V cofactors[9];
+		cross(&m[3], &m[6], &cofactors[0]);
+		cross(&m[6], &m[0], &cofactors[3]);
+		cross(&m[0], &m[3], &cofactors[6]);
+
+		const V det = Lanes::add(Lanes::add(
+			Lanes::mul(m[0], cofactors[0]),
+			Lanes::mul(m[1], cofactors[1])),
+			Lanes::mul(m[2], cofactors[2]));
+		alignas(32) float ones[width];
+		std::fill_n(ones, width, 1.0f);
+		const V inv_det = Lanes::div(Lanes::load(ones), det);
+
+		for (size_t e = 0; e < 9; e++) {
+			Lanes::store(elements[e], Lanes::mul(cofactors[e], inv_det));
+		}
+
+		// scatter back to array of structures
+		for (size_t i = 0; i < width; i++) {
+			for (int col = 0; col < 3; col++) {
+				for (int row = 0; row < 3; row++) {
+					normal_mats[i][col][row] = elements[(col * 3) + row][i];
+				}
+			}
+		}
+	}
+
+	void normalRange(const glm::mat4* models, glm::mat3* normal_mats, const size_t count)
+	{
+		size_t i = 0;
+		for (; (i + SimdLanes::width) <= count; i += SimdLanes::width) {
+			normalBlock<SimdLanes>(models + i, normal_mats + i);
+		}
+		for (; i < count; i++) {
+			normalBlock<ScalarLanes>(models + i, normal_mats + i);
+		}
+	}
+}
+
+namespace transform_batch
+{
+	void normalMatrices(const glm::mat4* models, glm::mat3* normal_mats, const size_t count)
+	{
+		if (count < (parallel_grain * 2)) {
+			normalRange(models, normal_mats, count);
+			return;
+		}
+
+		const size_t num_jobs = (count + parallel_grain - 1) / parallel_grain;
+		utils::parallelFor(num_jobs, [&](const size_t job) {
+			const size_t first = job * parallel_grain;
+			normalRange(models + first, normal_mats + first, std::min(parallel_grain, count - first));
+		});
+	}
+}
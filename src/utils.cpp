@@ -1,11 +1,28 @@
 #include "utils.h"
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <iostream>
 #include <source_location>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstddef>
 
 namespace utils {
 	ScopedDeleter::ScopedDeleter(void (*deleter)()) noexcept : deleter(deleter) {};
@@ -56,6 +73,184 @@ namespace utils {
 		return true;
 	}
 
+	namespace
+	{
+		// workers started once and reused by every parallelFor, so a call costs a wake up instead of a thread spawn
+		class WorkerPool
+		{
+		public:
+			WorkerPool()
+			{
+				const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+				for (size_t i = 1; i < hardware_threads; i++) {
+					workers.emplace_back([this]() { loop(); });
+				}
+			}
+			~WorkerPool()
+			{
+				{
+					std::lock_guard lock(mutex);
+					stopping = true;
+				}
+				wake.notify_all();
+				for (std::thread& worker : workers) {
+					worker.join();
+				}
+			}
+			WorkerPool(const WorkerPool& other) = delete;
+			WorkerPool& operator=(const WorkerPool& other) = delete;
+
+			// false if the pool is already running a job or this is one of its workers, the caller runs it alone then
+			bool run(const size_t count, const std::function<void(size_t)>& func)
+			{
+				std::unique_lock submit(submit_mutex, std::try_to_lock);
+				if (!submit.owns_lock() || in_worker || workers.empty()) return false;
+
+				{
+					std::lock_guard lock(mutex);
+					job = &func;
+					job_count = count;
+					next_index = 0;
+					busy_workers = workers.size();
+					generation++;
+				}
+				wake.notify_all();
+				work();
+
+				std::unique_lock lock(mutex);
+				done.wait(lock, [this]() { return busy_workers == 0; });
+				job = nullptr;
+				return true;
+			}
+
+		private:
+			// hand out indices one at a time so uneven work still balances
+			void work()
+			{
+				for (size_t i = next_index++; i < job_count; i = next_index++) {
+					(*job)(i);
+				}
+			}
+			void loop()
+			{
+				in_worker = true;
+				uint64_t seen_generation = 0;
+				while (true) {
+					{
+						std::unique_lock lock(mutex);
+						wake.wait(lock, [&]() { return stopping || (generation != seen_generation); });
+						if (stopping) return;
+						seen_generation = generation;
+					}
+					work();
+					std::lock_guard lock(mutex);
+					if (--busy_workers == 0) {
+						done.notify_one();
+					}
+				}
+			}
+
+			inline static thread_local bool in_worker = false;
+			std::mutex submit_mutex;
+			std::mutex mutex;
+			std::condition_variable wake;
+			std::condition_variable done;
+			const std::function<void(size_t)>* job = nullptr;
+			size_t job_count = 0;
+			std::atomic<size_t> next_index{0};
+			size_t busy_workers = 0;
+			uint64_t generation = 0;
+			bool stopping = false;
+			// started last so every member above exists before a worker reads it
+			std::vector<std::thread> workers;
+		};
+	}
+
+	void parallelFor(const size_t count, const std::function<void(size_t)>& func) {
+		static WorkerPool pool;
+		if ((count > 1) && pool.run(count, func)) return;
+
+		for (size_t i = 0; i < count; i++) {
+			func(i);
+		}
+	}
+
+	uint32_t crc32(const void* data, const size_t size, const uint32_t crc) {
+		// reflected ieee polynomial, one table lookup per byte
+		static constexpr std::array<uint32_t, 256> table = []() {
+			std::array<uint32_t, 256> entries{};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t entry = i;
+				for (int bit = 0; bit < 8; bit++) {
+					entry = (entry & 1) ? ((entry >> 1) ^ 0xEDB88320u) : (entry >> 1);
+				}
+				entries[i] = entry;
+			}
+			return entries;
+		}();
+
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint32_t value = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			value = table[(value ^ bytes[i]) & 0xFF] ^ (value >> 8);
+		}
+		return ~value;
+	}
+
+	void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool readVarint(const uint8_t*& pos, const uint8_t* end, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; (pos < end) && (shift < 64); shift += 7) {
+			const uint8_t byte = *pos++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+		return false;
+	}
+
+	bool syncFile(const std::string& path) {
+#ifdef _WIN32
+		const HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		const bool synced = FlushFileBuffers(file);
+		CloseHandle(file);
+#else
+		// fsync flushes the file itself, not just writes made through this descriptor
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+		const bool synced = (fsync(file) == 0);
+		::close(file);
+#endif
+		if (!synced) {
+			LOG("Unable to sync " << path)
+		}
+		return synced;
+	}
+
+	bool syncDirectory(const std::string& path) {
+#ifdef _WIN32
+		return true;
+#else
+		// a rename only changes the directory, syncing the file doesn't make it durable
+		const std::string directory = path.empty() ? "." : path;
+		const int file = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+		if (file < 0) return false;
+		const bool synced = (fsync(file) == 0);
+		::close(file);
+		if (!synced) {
+			LOG("Unable to sync " << directory)
+		}
+		return synced;
+#endif
+	}
+
     void FreeDelete::operator()(void* x) { free(x); }
 
 	err::err(const std::source_location& source) noexcept : source(source) {}
@@ -1,178 +1,942 @@
 #include "world.h"
 
 #include "component.h"
+#include "chunk.h"
+#include "chunk_mesher.h"
+#include "chunk_mesh.h"
 #include "utils.h"
+#include "instance.h"
+#include "instance_buffer.h"
+#include "frustum.h"
+#include "gpu_culler.h"
+#include "region_store.h"
+#include "world_saver.h"
+#include "edit_journal.h"
+#include "chunk_cache.h"
 
 #include "glm/mat4x4.hpp"
 #include "glm/mat3x3.hpp"
 #include "glm/vec4.hpp"
 #include "glm/vec3.hpp"
 #include "glm/ext/matrix_transform.hpp"
+#include "glm/common.hpp"
 #include "glad/gl.h"
 #include "entt/entity/registry.hpp"
-#include "entt/entity/snapshot.hpp"
 #include "PerlinNoise.hpp"
-#include "cereal/archives/binary.hpp"
 
 #include <string>
 #include <vector>
 #include <random>
 #include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <cstring>
+#include <chrono>
 #include <utility>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cmath>
 
-World::World() noexcept :
-	instancing_model_buffers((unsigned int)BlockId::NumNames),
-	instancing_normal_mat_buffers((unsigned int)BlockId::NumNames),
-	instancing_models((unsigned int)BlockId::NumNames),
-	instancing_normal_mats((unsigned int)BlockId::NumNames)
+World::World(const int view_radius) noexcept :
+	instances((unsigned int)BlockId::NumNames),
+	instance_entities((unsigned int)BlockId::NumNames),
+	region_store(std::make_unique<RegionStore>(region_path)),
+	saver(std::make_unique<WorldSaver>(*region_store, world_path, instance_cache_path)),
+	last_save_time(std::chrono::steady_clock::now()),
+	journal(std::make_unique<EditJournal>(journal_path)),
+	last_journal_commit(last_save_time),
+	view_radius(view_radius)
 {
-	glCreateBuffers(instancing_model_buffers.size(), instancing_model_buffers.data());
-	glCreateBuffers(instancing_normal_mat_buffers.size(), instancing_normal_mat_buffers.data());
-	if (loadAll()) {
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		instance_buffers.emplace_back(instance_buffer_mode);
+	}
+	// built either way so culling can switch at runtime
+	try {
+		gpu_culler = std::make_unique<GpuCuller>();
+	} catch (const std::runtime_error& e) {
+		LOG("Gpu culling unavailable, " << e.what())
+	}
+	setCullingMode(default_culling_mode);
+	const bool loaded = loadAll();
+	if (loaded) {
 		initData();
 	} else {
 		reset();
 	}
 	connect();
+	// edits made after the last save only exist in the journal
+	if (loaded) {
+		replayJournal();
+	}
 }
 
 World::~World()
 {
+	// the saver finishes writing this before it is destroyed, shutdown only waits for the final save
 	const Registry::iterable& it = world_registry.storage();
-	if (it.begin() != it.end()) {
-		saveAll();
+	if (saver && (!chunks.empty() || (it.begin() != it.end()))) {
+		// the final save retries whatever an earlier one failed to write
+		saver->wait();
+		if (std::optional<WorldSaver::Snapshot> failed = saver->takeFailed()) {
+			markUnsaved(std::move(*failed));
+		}
+		const bool saved = saveAll();
+		// the journal is only redundant once the save is on disk
+		saver->wait();
+		if (!saver->takeFailed() && saved) {
+			journal->dropRotated();
+		}
 	}
-	glDeleteBuffers(instancing_model_buffers.size(), instancing_model_buffers.data());
-	glDeleteBuffers(instancing_normal_mat_buffers.size(), instancing_normal_mat_buffers.data());
 }
 
 World::World(World&& other) noexcept :
-	instancing_model_buffers{std::exchange(other.instancing_model_buffers, {})},
-	instancing_normal_mat_buffers{std::exchange(other.instancing_normal_mat_buffers, {})},
-	instancing_models{std::move(other.instancing_models)},
-	instancing_normal_mats{std::move(other.instancing_normal_mats)},
-	connections{}
+	instance_buffers{std::move(other.instance_buffers)},
+	instances{std::move(other.instances)},
+	instance_entities{std::move(other.instance_entities)},
+	instance_slots{std::move(other.instance_slots)},
+	cell_entities{std::move(other.cell_entities)},
+	culling_mode{other.culling_mode},
+	gpu_culler{std::move(other.gpu_culler)},
+	instance_bounds{other.instance_bounds},
+	occlusion_culling{other.occlusion_culling},
+	connections{},
+	chunks{std::move(other.chunks)},
+	region_store{std::move(other.region_store)},
+	saver{std::move(other.saver)},
+	last_save_time{other.last_save_time},
+	dirty_chunks{std::move(other.dirty_chunks)},
+	unsaved_chunks{std::move(other.unsaved_chunks)},
+	saving_chunks{std::move(other.saving_chunks)},
+	world_dirty{other.world_dirty},
+	journal{std::move(other.journal)},
+	last_journal_commit{other.last_journal_commit},
+	journal_generation{other.journal_generation},
+	replaying{other.replaying},
+	instances_baked{other.instances_baked},
+	chunk_meshes{std::move(other.chunk_meshes)},
+	mesh_keys{std::move(other.mesh_keys)},
+	chunk_cache{std::move(other.chunk_cache)},
+	remesh_coords{std::move(other.remesh_coords)},
+	chunk_lods{std::move(other.chunk_lods)},
+	center_chunk{other.center_chunk},
+	view_radius{other.view_radius},
+	meshing_mode{other.meshing_mode},
+	streaming{other.streaming},
+	seed{other.seed}
 {
 	other.disconnect();
 	world_registry = std::exchange(other.world_registry, {});
 	connect();
 }
 
+World::EditTransaction::EditTransaction(World& world) noexcept :
+	world(world)
+{}
+
+World::EditTransaction::~EditTransaction()
+{
+	commit();
+}
+
+void World::EditTransaction::placeEntity(const BlockId id, const glm::vec3& pos)
+{
+	// the world streams further than a packed instance can address
+	if (!Instance::inRange(pos)) {
+		LOG("Block entity at " << pos.x << " " << pos.y << " " << pos.z << " is outside the instance range")
+		return;
+	}
+	place_ids.push_back(id);
+	place_positions.push_back(pos);
+}
+
+void World::EditTransaction::destroyEntity(const Entity entity)
+{
+	destroy_entities.push_back(entity);
+}
+
+void World::EditTransaction::setBlock(const glm::ivec3& cell, const BlockId id)
+{
+	block_edits.emplace_back(cell, id);
+}
+
+size_t World::EditTransaction::size() const
+{
+	return place_ids.size() + destroy_entities.size() + block_edits.size();
+}
+
+void World::EditTransaction::commit()
+{
+	if (size() == 0) return;
+
+	// the signals would patch instance data one entity at a time, this does it in bulk
+	world.disconnect();
+	Registry& registry = world.world_registry;
+
+	for (const Entity entity : destroy_entities) {
+		if (!registry.valid(entity)) continue;
+
+		if (registry.all_of<BlockId, Position>(entity)) {
+			const glm::vec3& pos = registry.get<Position>(entity).vec3;
+			world.removeInstance(registry.get<BlockId>(entity), entity, pos);
+			world.journalEdit({EditJournal::Edit::Type::DestroyEntity, registry.get<BlockId>(entity), {}, pos});
+		}
+		registry.destroy(entity);
+	}
+
+	if (!place_ids.empty()) {
+		std::vector<Entity> entities(place_ids.size());
+		registry.create(entities.begin(), entities.end());
+		std::vector<Position> components;
+		components.reserve(place_positions.size());
+		for (const glm::vec3& pos : place_positions) {
+			components.emplace_back(pos.x, pos.y, pos.z);
+		}
+		registry.insert<Position>(entities.begin(), entities.end(), components.begin());
+		registry.insert<BlockId>(entities.begin(), entities.end(), place_ids.begin());
+		world.addInstances(entities, place_ids, place_positions);
+		for (size_t i = 0; i < place_ids.size(); i++) {
+			world.journalEdit({EditJournal::Edit::Type::PlaceEntity, place_ids[i], {}, place_positions[i]});
+		}
+	}
+
+	// terrain edits only queue remeshes, every touched chunk is rebuilt once on the next update
+	for (const auto& [cell, id] : block_edits) {
+		world.setBlock(cell, id);
+	}
+
+	place_ids.clear();
+	place_positions.clear();
+	destroy_entities.clear();
+	block_edits.clear();
+	world.world_dirty = true;
+	world.connect();
+}
+
 void World::reset()
 {
+	// a save still writing would bring the old world back
+	saver->wait();
 	std::remove(world_path.c_str());
+	std::remove(instance_cache_path.c_str());
+	region_store->clear();
 	// Disconnect so we can handle all the data initalization in bulk instead of one at a time
 	disconnect();
 	generateWorld();
+	journal->reset(seed);
 	initData();
 	connect();
+	// written right away so a crash doesn't bring back a world whose journal is gone
+	saveAll();
 }
 
-void World::setupInstancing(const GLuint VAO, const GLuint vertex_attrib_index, const BlockId id) const
+void World::update(const glm::vec3& camera_position)
 {
-	GLuint cur_index = vertex_attrib_index;
-	GLuint end_index;
-	GLint num_components;
-	GLsizei stride;
-	void* pointer;
+	streamChunks(camera_position);
+	remeshChunks();
+	flushInstancingBuffers();
 
-	auto setupAttribArray = [](const GLuint& index, const GLint num_components, const GLsizei stride, const void* const pointer) -> void {
-		glEnableVertexAttribArray(index);
-		glVertexAttribPointer(index, num_components, GL_FLOAT, GL_FALSE, stride, pointer);
-		glVertexAttribDivisor(index, 1);
-	};
+	// edits of a whole frame or more share one sync
+	const auto now = std::chrono::steady_clock::now();
+	if (journal->hasPending() && ((now - last_journal_commit) >= journal_commit_interval)) {
+		journal->commit();
+		last_journal_commit = now;
+	}
+	if (((now - last_save_time) >= autosave_interval) || (journal->size() >= journal_compact_size)) {
+		saveAll();
+	}
+	if (!saver->busy()) {
+		// what a failed save held goes out with the next one, the rotated journals stay until then
+		if (std::optional<WorldSaver::Snapshot> failed = saver->takeFailed()) {
+			markUnsaved(std::move(*failed));
+		} else if (journal->hasRotated()) {
+			journal->dropRotated();
+		}
+		// their records are written now, so they are as safe to evict as any other clean chunk
+		for (auto& [coord, chunk] : saving_chunks) {
+			chunk_cache.putChunk(coord, std::move(chunk));
+		}
+		saving_chunks.clear();
+	}
+}
+
+void World::setViewRadius(const int radius)
+{
+	if (radius < 0) {
+		LOG("View radius must not be negative")
+		return;
+	}
 
-    glBindVertexArray(VAO);
+	view_radius = radius;
+	streaming = true;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, instancing_model_buffers[id.uint()]);
-	num_components = 4;
-	stride = sizeof(glm::mat4);
-	end_index = cur_index + 4;
-    for (int i = 0; cur_index < end_index; cur_index++, i++) {
-		pointer = (void*)(sizeof(glm::vec4) * i);
-		setupAttribArray(cur_index, num_components, stride, pointer);
-    }
+int World::getViewRadius() const
+{
+	return view_radius;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, instancing_normal_mat_buffers[id.uint()]);
-	num_components = 3;
-	stride = sizeof(glm::mat3);
-	end_index = cur_index + 3;
-    for (int i = 0; cur_index < end_index; cur_index++, i++) {
-		pointer = (void*)(sizeof(glm::vec3) * i);
-		setupAttribArray(cur_index, num_components, stride, pointer);
-    }
+size_t World::numChunks() const
+{
+	return chunks.size();
 }
 
-size_t World::numObjects(const BlockId id) const
+void World::setMeshingMode(const ChunkMesher::Mode mode)
 {
-	if (instancing_models[id.uint()].size() != instancing_normal_mats[id.uint()].size()) {
-		LOG("Unexpected size of instancing vector")
+	if (mode == meshing_mode) return;
+
+	meshing_mode = mode;
+	chunk_cache.clearMeshes();
+	for (const auto& [coord, chunk] : chunks) {
+		remesh_coords.insert(coord);
 	}
-	
-	return instancing_models[id.uint()].size();
+	remeshChunks();
+}
+
+ChunkMesher::Mode World::getMeshingMode() const
+{
+	return meshing_mode;
+}
+
+size_t World::numTerrainVertices() const
+{
+	size_t count = 0;
+	for (const auto& [coord, mesh] : chunk_meshes) {
+		count += mesh.numVertices();
+	}
+	return count;
+}
+
+size_t World::numTerrainTriangles() const
+{
+	size_t count = 0;
+	for (const auto& [coord, mesh] : chunk_meshes) {
+		count += mesh.numIndices() / 3;
+	}
+	return count;
+}
+
+BlockId World::getBlock(const glm::ivec3& cell) const
+{
+	ChunkCoord coord;
+	glm::ivec3 local;
+	splitCell(cell, coord, local);
+
+	const auto it = chunks.find(coord);
+	if (it == chunks.end()) {
+		return BlockId::Name::None;
+	}
+
+	return it->second->get(local);
 }
 
-void World::updateNormalMats(const glm::mat4& view)
+World::Entity World::blockEntity(const glm::ivec3& cell) const
 {
-	if (instancing_models.size() != instancing_normal_mats.size()) {
-		LOG("Unexpected size of instancing data")
+	const auto it = cell_entities.find(cell);
+	return (it == cell_entities.end()) ? Entity(entt::null) : it->second;
+}
+
+bool World::setBlock(const glm::ivec3& cell, const BlockId id)
+{
+	ChunkCoord coord;
+	glm::ivec3 local;
+	splitCell(cell, coord, local);
+
+	const auto it = chunks.find(coord);
+	if ((it == chunks.end()) || !Chunk::contains(local)) {
+		LOG("Unable to set block, cell is not loaded")
+		return false;
 	}
-	using ModelType = decltype(instancing_models)::value_type::value_type;
-	using NormalMatType = decltype(instancing_normal_mats)::value_type::value_type;
 
-	for (unsigned int i=0; i < (unsigned int)instancing_models.size(); i++) {
-		const std::vector<ModelType>& model_vec = instancing_models[i];
-		std::vector<NormalMatType>& normal_mat_vec = instancing_normal_mats[i];
+	// a background save may still be reading this chunk, edit a copy of it instead
+	if (it->second.use_count() > 1) {
+		it->second = std::make_shared<Chunk>(*it->second);
+	}
+	Chunk& chunk = *it->second;
+	const BlockId old_id = chunk.get(local);
+	if (!chunk.set(local, id)) {
+		return false;
+	}
 
-		for (unsigned int j=0; j < (unsigned int)model_vec.size(); j++) {
-			normal_mat_vec[j] = glm::transpose(glm::inverse(glm::mat3(view * model_vec[j])));
+	if (old_id != id) {
+		dirty_chunks.insert(coord);
+		journalEdit({EditJournal::Edit::Type::SetBlock, id, cell, {}});
+		const bool on_border = (local.x == 0) || (local.x == (Chunk::size - 1)) || (local.z == 0) || (local.z == (Chunk::size - 1));
+		queueRemesh(coord, on_border);
+		// cached meshes of this chunk and of neighbours meshed against its border are stale
+		chunk_cache.invalidateMeshes(coord);
+		if (on_border) {
+			chunk_cache.invalidateMeshes(ChunkCoord{coord.x + 1, coord.z});
+			chunk_cache.invalidateMeshes(ChunkCoord{coord.x - 1, coord.z});
+			chunk_cache.invalidateMeshes(ChunkCoord{coord.x, coord.z + 1});
+			chunk_cache.invalidateMeshes(ChunkCoord{coord.x, coord.z - 1});
 		}
+	}
 
-		const GLsizeiptr size_bytes = normal_mat_vec.size() * sizeof(NormalMatType);
-		glNamedBufferSubData(instancing_normal_mat_buffers[i], 0, size_bytes, normal_mat_vec.data());
+	return true;
+}
+
+void World::setupInstancing(const GLuint VAO, const GLuint vertex_attrib_index, const BlockId id, const std::vector<Mesh::Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Mesh::Texture>& textures) const
+{
+	instance_buffers[id.uint()].attach(VAO, vertex_attrib_index);
+	if (gpu_culler) {
+		gpu_culler->setBlockMesh(id, vertices, indices, textures);
+	}
+}
+
+bool World::setCullingMode(const CullingMode mode)
+{
+	if ((mode == CullingMode::Gpu) && !gpu_culler) {
+		LOG("Unable to cull on the gpu, the cull shader failed to build")
+		return false;
+	}
+
+	culling_mode = mode;
+	// the culled instances otherwise only make room on the next flush
+	reserveCulledInstances();
+	return true;
+}
+
+World::CullingMode World::getCullingMode() const
+{
+	return culling_mode;
+}
+
+void World::drawInstancesIndirect(const Shader& shader) const
+{
+	if (culling_mode == CullingMode::Gpu) {
+		gpu_culler->draw(shader);
+	}
+}
+
+size_t World::baseInstance(const BlockId id) const
+{
+	return instance_buffers[id.uint()].baseInstance();
+}
+
+void World::endFrame()
+{
+	for (InstanceBuffer& buffer : instance_buffers) {
+		buffer.fence();
+	}
+	last_cull_stats = std::exchange(cull_stats, {});
+}
+
+void World::cull(const glm::mat4& view_projection) const
+{
+	const Frustum frustum(view_projection);
+	if (occlusion_culling) {
+		rasterizeOccluders(view_projection, frustum);
+	}
+
+	visible_chunk_meshes.clear();
+	for (const auto& [coord, mesh] : chunk_meshes) {
+		if (mesh.numIndices() == 0) continue;
+
+		glm::vec3 min;
+		glm::vec3 max;
+		chunkBounds(coord, mesh, min, max);
+		if (!frustum.intersects(min, max)) {
+			cull_stats.chunks_culled++;
+			continue;
+		}
+		if (occlusion_culling) {
+			cull_stats.chunks_occlusion_tested++;
+			if (!occlusion_buffer.isVisible(min, max)) {
+				cull_stats.chunks_occluded++;
+				continue;
+			}
+		}
+		visible_chunk_meshes.push_back(&mesh);
+	}
+	cull_stats.chunks_drawn += visible_chunk_meshes.size();
+
+	if (culling_mode == CullingMode::Gpu) {
+		gpu_culler->cull(frustum, instance_buffers, instances);
+		return;
+	}
+
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		const Bounds& bounds = instance_bounds[i];
+		visible_instance_buckets[i] = !instances[i].empty() && frustum.intersects(bounds.min, bounds.max);
+		cull_stats.instance_buckets_culled += (!instances[i].empty() && !visible_instance_buckets[i]);
+	}
+}
+
+const World::CullStats& World::getCullStats() const
+{
+	return last_cull_stats;
+}
+
+void World::setOcclusionCulling(const bool enabled)
+{
+	occlusion_culling = enabled;
+}
+
+bool World::getOcclusionCulling() const
+{
+	return occlusion_culling;
+}
+
+void World::rasterizeOccluders(const glm::mat4& view_projection, const Frustum& frustum) const
+{
+	constexpr float half_size = chunk_size / 2.0f;
+	occlusion_buffer.begin(view_projection);
+	for (const ChunkCoord& coord : chunksInRadius(center_chunk, occluder_radius)) {
+		const auto it = chunk_meshes.find(coord);
+		if (it == chunk_meshes.end()) continue;
+
+		// solid ground below the lowest column of each quarter, anything behind it can't be seen
+		const std::array<int, 4>& heights = it->second.occluderHeights();
+		for (int quarter = 0; quarter < 4; quarter++) {
+			if (heights[quarter] == 0) continue;
+
+			const glm::vec3 min = coord.origin() + glm::vec3((quarter % 2) * half_size, min_height, (quarter / 2) * half_size);
+			const glm::vec3 max = min + glm::vec3(half_size, heights[quarter], half_size);
+			if (frustum.intersects(min, max) && occlusion_buffer.addOccluder(min, max)) {
+				cull_stats.occluders_rasterized++;
+			}
+		}
+	}
+}
+
+size_t World::numVisibleObjects(const BlockId id) const
+{
+	return visible_instance_buckets[id.uint()] ? instances[id.uint()].size() : 0;
+}
+
+size_t World::numObjects(const BlockId id) const
+{
+	return instances[id.uint()].size();
+}
+
+void World::drawChunks(const BlockId id) const
+{
+	for (const ChunkMesh* const mesh : visible_chunk_meshes) {
+		mesh->draw(id);
 	}
 }
 
 void World::generateWorld()
 {
 	world_registry.clear();
+	chunks.clear();
+	dirty_chunks.clear();
+	unsaved_chunks.clear();
+	saving_chunks.clear();
+	chunk_cache.clear();
+	world_dirty = true;
+	seed = std::random_device()();
+
+	loadChunks(chunksInRadius(center_chunk, view_radius));
+	streaming = false;
+}
 
-	const siv::PerlinNoise::seed_type seed = std::random_device()();
+void World::streamChunks(const glm::vec3& camera_position)
+{
+	const ChunkCoord new_center = ChunkCoord::fromPosition(camera_position);
+	if ((new_center == center_chunk) && !streaming) return;
+	world_dirty |= (new_center != center_chunk);
+	center_chunk = new_center;
+
+	const int unload_radius = view_radius + unload_margin;
+	std::vector<ChunkCoord> unload_coords;
+	for (const auto& [coord, chunk] : chunks) {
+		if (coord.distanceSquared(center_chunk) > (unload_radius * unload_radius)) {
+			unload_coords.push_back(coord);
+		}
+	}
+
+	std::vector<ChunkCoord> load_coords;
+	for (const ChunkCoord& coord : chunksInRadius(center_chunk, view_radius)) {
+		if (!chunks.contains(coord)) {
+			load_coords.push_back(coord);
+		}
+	}
+	// closest chunks are generated first, the rest are picked up by later updates
+	streaming = (load_coords.size() > max_chunk_loads_per_update);
+	if (streaming) {
+		load_coords.resize(max_chunk_loads_per_update);
+	}
+
+	for (const ChunkCoord& coord : unload_coords) {
+		// edits survive the unload, the next snapshot still saves them
+		std::shared_ptr<Chunk>& chunk = chunks.at(coord);
+		if (dirty_chunks.erase(coord)) {
+			unsaved_chunks.insert_or_assign(coord, std::move(chunk));
+		} else if (chunk.use_count() > 1) {
+			// a queued save still holds it, so its region record isn't written yet
+			saving_chunks.insert_or_assign(coord, std::move(chunk));
+		} else {
+			chunk_cache.putChunk(coord, std::move(chunk));
+		}
+		chunks.erase(coord);
+		chunk_lods.erase(coord);
+		// the mesh is dropped once the queue notices the chunk is gone
+		queueRemesh(coord, true);
+	}
+	loadChunks(load_coords);
+	for (const ChunkCoord& coord : load_coords) {
+		queueRemesh(coord, true);
+	}
+	updateLods();
+}
+
+int World::chunkLod(const ChunkCoord& coord, const int current) const
+{
+	const float distance = std::sqrt(static_cast<float>(coord.distanceSquared(center_chunk)));
+	const int lod = std::min(static_cast<int>(distance / lod_distance), ChunkMesher::num_lods - 1);
+	if ((current < 0) || (lod == current)) return lod;
+
+	// the boundary next to the current level, a chunk has to clear it by the hysteresis before it switches
+	const float boundary = static_cast<float>(((lod > current) ? (current + 1) : current) * lod_distance);
+	return (std::abs(distance - boundary) < lod_hysteresis) ? current : lod;
+}
+
+void World::updateLods()
+{
+	for (auto& [coord, lod] : chunk_lods) {
+		const int new_lod = chunkLod(coord, lod);
+		if (new_lod != lod) {
+			lod = new_lod;
+			// neighbours switch between sharing their border and hanging a skirt over it
+			queueRemesh(coord, true);
+		}
+	}
+}
+
+void World::loadChunks(const std::vector<ChunkCoord>& coords)
+{
+	// chunks that unloaded with unsaved edits come back as they were, the region files don't have them yet
+	std::vector<ChunkCoord> read_coords;
+	for (const ChunkCoord& coord : coords) {
+		const auto it = unsaved_chunks.find(coord);
+		const auto saving_it = saving_chunks.find(coord);
+		if (it != unsaved_chunks.end()) {
+			chunks.insert_or_assign(coord, std::move(it->second));
+			dirty_chunks.insert(coord);
+			unsaved_chunks.erase(it);
+		} else if (saving_it != saving_chunks.end()) {
+			// shared with the save, an edit copies it first, and it goes back if it unloads before the save is done
+			chunks.insert_or_assign(coord, std::move(saving_it->second));
+			saving_chunks.erase(saving_it);
+		} else if (std::shared_ptr<Chunk> cached = chunk_cache.takeChunk(coord)) {
+			chunks.insert_or_assign(coord, std::move(cached));
+		} else {
+			read_coords.push_back(coord);
+		}
+	}
+
+	std::vector<Chunk> loaded = readChunks(read_coords);
+	for (size_t i = 0; i < read_coords.size(); i++) {
+		chunks.insert_or_assign(read_coords[i], std::make_shared<Chunk>(std::move(loaded[i])));
+	}
+}
+
+Chunk World::generateChunk(const ChunkCoord& coord) const
+{
 	const siv::BasicPerlinNoise<float> perlin(seed);
+	Chunk chunk;
+	const glm::vec3 origin = coord.origin();
 
-	for (unsigned int x = 0; x < chunk_size; x++) {
-		for (unsigned int z = 0; z < chunk_size; z++) {
-			const float perlin_x = x * noise_scale;
-			const float perlin_z = z * noise_scale;
+	for (int x = 0; x < chunk_size; x++) {
+		for (int z = 0; z < chunk_size; z++) {
+			const float perlin_x = (origin.x + x) * noise_scale;
+			const float perlin_z = (origin.z + z) * noise_scale;
 			constexpr float max_noise_val = std::tuple_size<decltype(perlin)::state_type>{};
-			if ((perlin_x > max_noise_val) && (perlin_z > max_noise_val)) {
+			if ((std::abs(perlin_x) > max_noise_val) && (std::abs(perlin_z) > max_noise_val)) {
 				LOG("Perlin noise is outside expected input values")
 			}
 			// perlin noise is [-1, 1]
 			const float noise = perlin.normalizedOctave2D(perlin_x, perlin_z, 3/*octaves*/, 0.5f/*persistence*/);
-			const float adjusted_noise = std::roundf(noise * terrain_amplitude + terrain_median_height);
-			// add block_half length so that blocks meet at whole numbers
-			const float surface_level_position = adjusted_noise + (utils::sign(adjusted_noise) * block_half_length);
-			const float bedrock_position = min_height + block_half_length;
-			for (float y=bedrock_position; y<=surface_level_position; y++) {
-				Registry::entity_type entity = world_registry.create();
-				// center around zero, on increments of block_half_length
-				const float float_x = (x + block_half_length) - (chunk_size / 2.0f);
-				const float float_z = (z + block_half_length) - (chunk_size / 2.0f);
-				world_registry.emplace<Position>(entity, float_x, y, float_z);
-				if (y < surface_level_position) {
-					world_registry.emplace<BlockId>(entity, BlockId::Name::Dirt);
-				} else {
-					world_registry.emplace<BlockId>(entity, BlockId::Name::Grass);
-				}
+			const int surface_level = static_cast<int>(std::roundf(noise * terrain_amplitude + terrain_median_height));
+			const int top = std::min(surface_level, max_height - 1) - min_height;
+			for (int y = 0; y <= top; y++) {
+				const BlockId id = (y < top) ? BlockId::Name::Dirt : BlockId::Name::Grass;
+				chunk.set(glm::ivec3(x, y, z), id);
+			}
+		}
+	}
+
+	return chunk;
+}
+
+void World::splitCell(const glm::ivec3& cell, ChunkCoord& coord, glm::ivec3& local)
+{
+	coord = ChunkCoord::fromPosition(glm::vec3(cell));
+	const glm::vec3 origin = coord.origin();
+	local = glm::ivec3(cell.x - static_cast<int>(origin.x), cell.y - min_height, cell.z - static_cast<int>(origin.z));
+}
+
+glm::vec3 World::cellCenter(const ChunkCoord& coord, const glm::ivec3& local)
+{
+	const glm::vec3 origin = coord.origin();
+	return glm::vec3(
+		origin.x + local.x + block_half_length,
+		min_height + local.y + block_half_length,
+		origin.z + local.z + block_half_length
+	);
+}
+
+ChunkMesher::Neighbours World::neighbours(const ChunkCoord& coord) const
+{
+	// borders between levels of detail are left open so the coarser side's walls cover the seam
+	const int lod = chunk_lods.at(coord);
+	auto find = [this, lod](const ChunkCoord& neighbour) -> const Chunk* {
+		const auto it = chunks.find(neighbour);
+		const auto lod_it = chunk_lods.find(neighbour);
+		if ((it == chunks.end()) || (lod_it == chunk_lods.end()) || (lod_it->second != lod)) return nullptr;
+		return it->second.get();
+	};
+
+	return ChunkMesher::Neighbours{
+		find(ChunkCoord{coord.x + 1, coord.z}),
+		find(ChunkCoord{coord.x - 1, coord.z}),
+		find(ChunkCoord{coord.x, coord.z + 1}),
+		find(ChunkCoord{coord.x, coord.z - 1})
+	};
+}
+
+ChunkCache::MeshKey World::meshKey(const ChunkCoord& coord) const
+{
+	ChunkCache::MeshKey key{chunk_lods.at(coord), 0};
+	const ChunkMesher::Neighbours adjacent = neighbours(coord);
+	for (size_t i = 0; i < adjacent.size(); i++) {
+		key.neighbours |= static_cast<uint8_t>(adjacent[i] ? (1 << i) : 0);
+	}
+	return key;
+}
+
+void World::queueRemesh(const ChunkCoord& coord, const bool include_neighbours)
+{
+	remesh_coords.insert(coord);
+	if (include_neighbours) {
+		remesh_coords.insert(ChunkCoord{coord.x + 1, coord.z});
+		remesh_coords.insert(ChunkCoord{coord.x - 1, coord.z});
+		remesh_coords.insert(ChunkCoord{coord.x, coord.z + 1});
+		remesh_coords.insert(ChunkCoord{coord.x, coord.z - 1});
+	}
+}
+
+void World::remeshChunks()
+{
+	if (remesh_coords.empty()) return;
+
+	std::vector<ChunkCoord> coords;
+	for (const ChunkCoord& coord : remesh_coords) {
+		if (chunks.contains(coord)) {
+			coords.push_back(coord);
+			continue;
+		}
+		// the gpu buffers of a chunk that streamed out are kept in case it streams back in
+		const auto mesh_it = chunk_meshes.find(coord);
+		if (mesh_it != chunk_meshes.end()) {
+			chunk_cache.putMesh(coord, mesh_keys.at(coord), std::move(mesh_it->second));
+			chunk_meshes.erase(mesh_it);
+			mesh_keys.erase(coord);
+		}
+	}
+	remesh_coords.clear();
+	// new chunks pick their level of detail before any neighbour looks at it
+	for (const ChunkCoord& coord : coords) {
+		chunk_lods.try_emplace(coord, chunkLod(coord, -1));
+	}
+
+	// cached gpu buffers are reused as they are, cached mesh data only has to be uploaded
+	std::vector<ChunkCoord> mesh_coords;
+	std::vector<ChunkCache::MeshKey> keys;
+	for (const ChunkCoord& coord : coords) {
+		const ChunkCache::MeshKey key = meshKey(coord);
+		ChunkMesh mesh;
+		if (chunk_cache.takeMesh(coord, key, mesh)) {
+			chunk_meshes.insert_or_assign(coord, std::move(mesh));
+		} else if (const ChunkMesher::MeshData* data = chunk_cache.findMeshData(coord, key)) {
+			chunk_meshes.insert_or_assign(coord, ChunkMesh(*data, cellCenter(coord, glm::ivec3(0))));
+		} else {
+			mesh_coords.push_back(coord);
+			keys.push_back(key);
+			continue;
+		}
+		mesh_keys.insert_or_assign(coord, key);
+	}
+
+	// meshing only reads chunk data so it can run on every core, uploading has to stay on this thread
+	std::vector<ChunkMesher::MeshData> mesh_data(mesh_coords.size());
+	utils::parallelFor(mesh_coords.size(), [&](const size_t i) {
+		mesh_data[i] = ChunkMesher::mesh(*chunks.at(mesh_coords[i]), neighbours(mesh_coords[i]), meshing_mode, keys[i].lod);
+	});
+
+	for (size_t i = 0; i < mesh_coords.size(); i++) {
+		chunk_meshes.insert_or_assign(mesh_coords[i], ChunkMesh(mesh_data[i], cellCenter(mesh_coords[i], glm::ivec3(0))));
+		mesh_keys.insert_or_assign(mesh_coords[i], keys[i]);
+		chunk_cache.putMeshData(mesh_coords[i], keys[i], std::move(mesh_data[i]));
+	}
+}
+
+void World::chunkBounds(const ChunkCoord& coord, const ChunkMesh& mesh, glm::vec3& min, glm::vec3& max)
+{
+	min = coord.origin() + glm::vec3(0.0f, min_height + mesh.bottom(), 0.0f);
+	max = coord.origin() + glm::vec3(chunk_size, min_height + mesh.top(), chunk_size);
+}
+
+std::vector<ChunkCoord> World::chunksInRadius(const ChunkCoord& center, const int radius) const
+{
+	std::vector<ChunkCoord> coords;
+	for (int x = center.x - radius; x <= center.x + radius; x++) {
+		for (int z = center.z - radius; z <= center.z + radius; z++) {
+			const ChunkCoord coord{x, z};
+			if (coord.distanceSquared(center) <= (radius * radius)) {
+				coords.push_back(coord);
+			}
+		}
+	}
+
+	std::sort(coords.begin(), coords.end(), [&center](const ChunkCoord& one, const ChunkCoord& two) {
+		return one.distanceSquared(center) < two.distanceSquared(center);
+	});
+	return coords;
+}
+
+std::vector<Chunk> World::readChunks(const std::vector<ChunkCoord>& coords) const
+{
+	std::vector<Chunk> loaded;
+	std::vector<uint8_t> found;
+	region_store->load(coords, loaded, found);
+	utils::parallelFor(coords.size(), [&](const size_t i) {
+		if (!found[i]) {
+			loaded[i] = generateChunk(coords[i]);
+		}
+	});
+	return loaded;
+}
+
+void World::replayJournal()
+{
+	std::vector<EditJournal::Edit> edits;
+	if (!journal->open(seed, journal_generation, edits) || edits.empty()) return;
+
+	std::vector<ChunkCoord> coords;
+	std::unordered_set<ChunkCoord> coord_set;
+	for (const EditJournal::Edit& edit : edits) {
+		ChunkCoord coord;
+		glm::ivec3 local;
+		splitCell(edit.cell, coord, local);
+		if ((edit.type == EditJournal::Edit::Type::SetBlock) && coord_set.insert(coord).second) {
+			coords.push_back(coord);
+		}
+	}
+	std::vector<Chunk> edited = readChunks(coords);
+	for (size_t i = 0; i < coords.size(); i++) {
+		unsaved_chunks.insert_or_assign(coords[i], std::make_shared<Chunk>(std::move(edited[i])));
+	}
+
+	// in journal order, entity signals keep the instance data up to date
+	replaying = true;
+	for (const EditJournal::Edit& edit : edits) {
+		switch (edit.type) {
+		case EditJournal::Edit::Type::SetBlock: {
+			ChunkCoord coord;
+			glm::ivec3 local;
+			splitCell(edit.cell, coord, local);
+			unsaved_chunks.at(coord)->set(local, edit.id);
+			break;
+		}
+		case EditJournal::Edit::Type::PlaceEntity: {
+			// a save can hold the placement already if it ran and the journal wasn't dropped before the crash
+			if (blockEntity(instanceCell(edit.pos)) != entt::null) break;
+
+			const Entity entity = world_registry.create();
+			world_registry.emplace<Position>(entity, edit.pos.x, edit.pos.y, edit.pos.z);
+			world_registry.emplace<BlockId>(entity, edit.id);
+			break;
+		}
+		case EditJournal::Edit::Type::DestroyEntity: {
+			const Entity entity = blockEntity(instanceCell(edit.pos));
+			if (entity != entt::null) {
+				world_registry.destroy(entity);
 			}
+			break;
+		}
 		}
 	}
+	replaying = false;
+	world_dirty = true;
+	LOG("Replayed " << edits.size() << " journaled edits, the last run ended before saving them")
+
+	// fold them into the save files right away, the journal is dropped once they are written
+	saveAll();
+}
+
+void World::journalEdit(const EditJournal::Edit& edit)
+{
+	if (!replaying) {
+		journal->append(edit);
+	}
+}
+
+bool World::saveAll()
+{
+	// everything journaled so far is part of this snapshot, the rotated journal goes once the save is on disk
+	last_save_time = std::chrono::steady_clock::now();
+	switch (journal->rotate()) {
+	case EditJournal::Rotation::Empty:
+		break;
+	case EditJournal::Rotation::Rotated:
+		world_dirty = true;
+		break;
+	case EditJournal::Rotation::Failed:
+		// the save wouldn't cover the generation still holding its edits, they would replay over it on the next start
+		LOG("Save skipped, the journal couldn't be rotated")
+		return false;
+	}
+	saver->save(snapshot<ALLCOMPONENTS>());
+	return true;
+}
+
+void World::markUnsaved(WorldSaver::Snapshot&& snapshot)
+{
+	// registry pools are small, writing world.bin again is cheaper than tracking whether this save held it
+	world_dirty = true;
+	for (const auto& [coord, chunk] : snapshot.chunks) {
+		if (chunks.contains(coord)) {
+			dirty_chunks.insert(coord);
+			continue;
+		}
+		// edited again since the snapshot, the newer copy is already waiting
+		if (unsaved_chunks.contains(coord)) continue;
+
+		if (const auto saving_it = saving_chunks.find(coord); saving_it != saving_chunks.end()) {
+			unsaved_chunks.insert_or_assign(coord, std::move(saving_it->second));
+			saving_chunks.erase(saving_it);
+		} else if (std::shared_ptr<Chunk> cached = chunk_cache.takeChunk(coord)) {
+			// it unloaded after the failed write let go of it
+			unsaved_chunks.insert_or_assign(coord, std::move(cached));
+		} else {
+			// evicted, it wasn't edited since the snapshot or it would be unsaved
+			unsaved_chunks.emplace(coord, std::make_shared<Chunk>(*chunk));
+		}
+	}
+	LOG("Save failed, " << snapshot.chunks.size() << " chunks are kept for the next one")
+}
+
+WorldSaver::Stats World::getSaveStats() const
+{
+	return saver->getStats();
+}
+
+void World::setChunkCacheBudgets(const ChunkCache::Budgets& budgets)
+{
+	chunk_cache.setBudgets(budgets);
 }
 
-void World::saveAll() const
+const ChunkCache::Stats& World::getChunkCacheStats() const
 {
-	save<ALLCOMPONENTS>(world_path);
+	return chunk_cache.getStats();
 }
 
 bool World::loadAll()
@@ -181,21 +945,68 @@ bool World::loadAll()
 }
 
 template <typename... Component>
-void World::save(const std::string& path) const
+WorldSaver::Snapshot World::snapshot()
 {
-	std::ofstream stream;
-	stream.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
-	const entt::basic_snapshot<Registry> snapshot(world_registry);
-	cereal::BinaryOutputArchive archive{stream};
+	WorldSaver::Snapshot world_snapshot;
+	// the registry can't be read off this thread, but it is small now that terrain lives in chunks
+	if (world_dirty) {
+		std::string& bytes = world_snapshot.world_bytes;
+		auto append = [&bytes](const void* data, const size_t size) {
+			bytes.append(static_cast<const char*>(data), size);
+		};
 
-	snapshot.get<Entity>(archive);
-	([&]()
-	{
-		snapshot.get<Component>(archive);
-	}(), ...);
+		// terrain goes to the region files, world.bin only keeps what isn't tied to a chunk
+		const SaveHeader header{save_magic, save_version, seed, center_chunk.x, center_chunk.z,
+			journal->coveredGeneration(), sizeof...(Component)};
+		append(&header, sizeof(SaveHeader));
+
+		// each pool is written as two columns, entity numbers then the packed components
+		uint32_t tag = 0;
+		uint32_t source_hash = 0;
+		([&]()
+		{
+			static_assert(std::is_trivially_copyable_v<Component>);
+			const auto& storage = world_registry.storage<Component>();
+			std::vector<uint32_t> numbers;
+			std::vector<Component> components;
+			numbers.reserve(storage.size());
+			components.reserve(storage.size());
+			for (auto&& [entity, component] : storage.each()) {
+				numbers.push_back(static_cast<uint32_t>(entt::to_entity(entity)));
+				components.push_back(component);
+			}
+
+			const size_t numbers_size = numbers.size() * sizeof(uint32_t);
+			const size_t components_size = components.size() * sizeof(Component);
+			uint32_t crc = utils::crc32(numbers.data(), numbers_size);
+			crc = utils::crc32(components.data(), components_size, crc);
+			const PoolHeader pool{tag++, sizeof(Component), static_cast<uint32_t>(numbers.size()), crc};
+			source_hash = utils::crc32(&pool, sizeof(PoolHeader), source_hash);
+			append(&pool, sizeof(PoolHeader));
+			append(numbers.data(), numbers_size);
+			append(components.data(), components_size);
+		}(), ...);
+		if (cache_instances) {
+			world_snapshot.cache_bytes = bakeInstances(source_hash);
+		}
+		world_dirty = false;
+	}
+
+	// only edited chunks are written, so a save costs what changed rather than what is loaded
+	world_snapshot.chunks.reserve(dirty_chunks.size() + unsaved_chunks.size());
+	for (const ChunkCoord& coord : dirty_chunks) {
+		world_snapshot.chunks.emplace_back(coord, chunks.at(coord));
+	}
+	for (auto& [coord, chunk] : unsaved_chunks) {
+		world_snapshot.chunks.emplace_back(coord, chunk);
+		saving_chunks.insert_or_assign(coord, std::move(chunk));
+	}
+	dirty_chunks.clear();
+	unsaved_chunks.clear();
+	return world_snapshot;
 }
 template
-void World::save<ALLCOMPONENTS>(const std::string& path) const;
+WorldSaver::Snapshot World::snapshot<ALLCOMPONENTS>();
 
 template <typename... Component>
 bool World::load(const std::string& path)
@@ -203,68 +1014,213 @@ bool World::load(const std::string& path)
 	std::ifstream stream;
 	stream.open(path, std::ios::in | std::ios::binary);
 	if (!stream) { return false; }
-	entt::basic_snapshot_loader<Registry> snapshot_loader(world_registry);
-	cereal::BinaryInputArchive archive{stream};
+	const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+
+	SaveHeader header;
+	if (bytes.size() >= sizeof(SaveHeader)) {
+		std::memcpy(&header, bytes.data(), sizeof(SaveHeader));
+	}
+	if ((bytes.size() < sizeof(SaveHeader)) || (header.magic != save_magic) || (header.version != save_version)
+		|| (header.num_pools != sizeof...(Component))) {
+		LOG("Discarding world saved in an older format")
+		return false;
+	}
 
-	snapshot_loader.get<Entity>(archive);
+	// every pool is checked before the registry is touched, so a corrupt file leaves it empty
+	struct Pool {
+		const uint8_t* numbers = nullptr;
+		const uint8_t* components = nullptr;
+		uint32_t count = 0;
+	};
+	std::array<Pool, sizeof...(Component)> pools{};
+	size_t pos = sizeof(SaveHeader);
+	uint32_t tag = 0;
+	uint32_t source_hash = 0;
+	bool valid = true;
 	([&]()
 	{
-		snapshot_loader.get<Component>(archive);
+		PoolHeader pool;
+		if (!valid || ((pos + sizeof(PoolHeader)) > bytes.size())) {
+			valid = false;
+			return;
+		}
+		std::memcpy(&pool, bytes.data() + pos, sizeof(PoolHeader));
+		pos += sizeof(PoolHeader);
+		const size_t size = static_cast<size_t>(pool.count) * (sizeof(uint32_t) + sizeof(Component));
+		if ((pool.tag != tag) || (pool.element_size != sizeof(Component)) || ((pos + size) > bytes.size())
+			|| (utils::crc32(bytes.data() + pos, size) != pool.crc)) {
+			valid = false;
+			return;
+		}
+		source_hash = utils::crc32(&pool, sizeof(PoolHeader), source_hash);
+		pools[tag++] = Pool{bytes.data() + pos, bytes.data() + pos + (pool.count * sizeof(uint32_t)), pool.count};
+		pos += size;
 	}(), ...);
+	if (!valid) {
+		LOG("World save is corrupt")
+		return false;
+	}
+
+	seed = header.seed;
+	center_chunk = ChunkCoord{header.center_x, header.center_z};
+	journal_generation = header.journal_generation;
+
+	// saved entity numbers are remapped onto entities created in one bulk call
+	std::vector<uint32_t> numbers;
+	uint32_t max_number = 0;
+	for (const Pool& pool : pools) {
+		const size_t first = numbers.size();
+		numbers.resize(first + pool.count);
+		std::memcpy(numbers.data() + first, pool.numbers, pool.count * sizeof(uint32_t));
+	}
+	for (const uint32_t number : numbers) {
+		max_number = std::max(max_number, number);
+	}
+	std::vector<uint8_t> referenced(numbers.empty() ? 0 : (static_cast<size_t>(max_number) + 1), 0);
+	for (const uint32_t number : numbers) {
+		referenced[number] = 1;
+	}
+	std::vector<Entity> created(std::count(referenced.begin(), referenced.end(), 1));
+	world_registry.create(created.begin(), created.end());
+	std::vector<Entity> remap(referenced.size(), static_cast<Entity>(entt::null));
+	for (size_t number = 0, next = 0; number < referenced.size(); number++) {
+		if (referenced[number]) {
+			remap[number] = created[next++];
+		}
+	}
+
+	// one bulk insert per pool
+	tag = 0;
+	size_t first = 0;
+	([&]()
+	{
+		const Pool& pool = pools[tag++];
+		std::vector<Entity> entities(pool.count);
+		for (uint32_t i = 0; i < pool.count; i++) {
+			entities[i] = remap[numbers[first + i]];
+		}
+		std::vector<Component> components(pool.count);
+		std::memcpy(static_cast<void*>(components.data()), pool.components, pool.count * sizeof(Component));
+		world_registry.insert<Component>(entities.begin(), entities.end(), components.begin());
+		first += pool.count;
+	}(), ...);
+
+	// initData rebuilds the buckets unless the cache was baked from exactly these pools
+	instances_baked = cache_instances && loadBakedInstances(remap, source_hash);
+
+	// no chunk is read yet, updates stream them in closest first straight out of the mapped region files
+	chunks.clear();
+	streaming = true;
 
 	return true;
 }
 template
 bool World::load<ALLCOMPONENTS>(const std::string& path);
 
-void World::onPositionBlockIdConstruct(const Registry& registry, const Entity entity)
+void World::addInstance(const BlockId id, const Entity entity, const glm::vec3& pos)
 {
-	// only operate when both components have been removed
-	if (!registry.all_of<BlockId, Position>(entity)) return;
-
-	const BlockId id = registry.get<BlockId>(entity);
-	const glm::vec3& pos = registry.get<Position>(entity).vec3;
-	glm::mat4 model = glm::mat4(1.0f);
-	model = glm::translate(model, pos);
+	instances[id.uint()].push_back(Instance::fromPosition(pos));
+	instance_entities[id.uint()].push_back(entity);
+	const size_t index = instances[id.uint()].size() - 1;
+	instance_buffers[id.uint()].markDirty(index, index + 1);
 
-	instancing_models[id.uint()].push_back(std::move(model));
-	instancing_normal_mats[id.uint()].push_back(glm::mat3(1.0f));
-	// append it to the appropriate buffer
-	updateInstancingBuffers(id, true, (instancing_models[id.uint()].size() - 1));
+	const size_t entity_number = static_cast<size_t>(entt::to_entity(entity));
+	if (entity_number >= instance_slots.size()) {
+		instance_slots.resize(entity_number + 1);
+	}
+	instance_slots[entity_number] = index;
+	cell_entities.insert_or_assign(instanceCell(pos), entity);
 }
 
-void World::onPositionBlockIdDestruct(const Registry& registry, const Entity entity)
+bool World::removeInstance(const BlockId id, const Entity entity, const glm::vec3& pos)
 {
-	// only operate when both components have been removed
-	if (!registry.all_of<BlockId, Position>(entity)) return;
+	std::vector<Instance>& instance_vec = instances[id.uint()];
+	std::vector<Entity>& entity_vec = instance_entities[id.uint()];
+	const size_t entity_number = static_cast<size_t>(entt::to_entity(entity));
+	if ((entity_number >= instance_slots.size()) || (instance_slots[entity_number] >= entity_vec.size()) ||
+		(entity_vec[instance_slots[entity_number]] != entity)) {
+		LOG("Failed to remove instance from instance_vector")
+		return false;
+	}
 
-	const BlockId id = registry.get<BlockId>(entity);
-	const glm::vec3& pos = registry.get<Position>(entity).vec3;
-	// TODO do I really need this?
-	if ((instancing_models[id.uint()].size() == 0) || (instancing_normal_mats[id.uint()].size() == 0)) {
-		LOG("Instancing data size does not match entt registry")
-		return;
+	// the last instance moves into the freed slot, point its entity at the new slot
+	const size_t index = instance_slots[entity_number];
+	utils::vecSwapPopBack(instance_vec, index);
+	utils::vecSwapPopBack(entity_vec, index);
+	if (index < entity_vec.size()) {
+		instance_slots[static_cast<size_t>(entt::to_entity(entity_vec[index]))] = index;
+		instance_buffers[id.uint()].markDirty(index, index + 1);
+	}
+
+	const auto it = cell_entities.find(instanceCell(pos));
+	if ((it != cell_entities.end()) && (it->second == entity)) {
+		cell_entities.erase(it);
+	}
+	return true;
+}
+
+void World::addInstances(const std::vector<Entity>& entities, const std::vector<BlockId>& ids, const std::vector<glm::vec3>& positions)
+{
+	std::vector<std::vector<glm::vec3>> bucket_positions(instances.size());
+	std::vector<std::vector<Entity>> bucket_entities(instances.size());
+	for (size_t i = 0; i < entities.size(); i++) {
+		bucket_positions[ids[i].uint()].push_back(positions[i]);
+		bucket_entities[ids[i].uint()].push_back(entities[i]);
 	}
 
-	using ModelType = decltype(instancing_models)::value_type::value_type;
-	using NormalMatType = decltype(instancing_normal_mats)::value_type::value_type;
+	for (unsigned int i = 0; i < instances.size(); i++) {
+		const size_t count = bucket_positions[i].size();
+		if (count == 0) continue;
 
-	std::vector<ModelType>& model_vec = instancing_models[id.uint()];
-	std::vector<NormalMatType>& normal_mat_vec = instancing_normal_mats[id.uint()];
-	for (unsigned int i=0; i < (unsigned int)model_vec.size(); i++) {
-		// row 3 of a 4x4 is the translation
-		if (glm::vec3(model_vec[i][3]) != pos) {
-			continue;
-		} else {
-			utils::vecSwapPopBack(model_vec, i);
-			utils::vecSwapPopBack(normal_mat_vec, i);
-			updateInstancingBuffers(id, true, i);
-		}
+		const size_t first = instances[i].size();
+		instances[i].resize(first + count);
+		Instance::fromPositions(bucket_positions[i].data(), instances[i].data() + first, count);
+		instance_entities[i].insert(instance_entities[i].end(), bucket_entities[i].begin(), bucket_entities[i].end());
+		instance_buffers[i].markDirty(first, first + count);
 
-		return;
+		for (size_t j = 0; j < count; j++) {
+			const size_t entity_number = static_cast<size_t>(entt::to_entity(bucket_entities[i][j]));
+			if (entity_number >= instance_slots.size()) {
+				instance_slots.resize(entity_number + 1);
+			}
+			instance_slots[entity_number] = first + j;
+			cell_entities.insert_or_assign(instanceCell(bucket_positions[i][j]), bucket_entities[i][j]);
+		}
 	}
+}
 
-	LOG("Failed to remove entity from instance_vector")
+glm::ivec3 World::instanceCell(const glm::vec3& pos)
+{
+	return glm::ivec3(glm::floor(pos));
+}
+
+size_t World::CellHash::operator()(const glm::ivec3& cell) const noexcept
+{
+	// 24 bits each for x and z and 16 for y covers any reachable cell
+	const uint64_t key = ((static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) & 0xFFFFFF) << 40) |
+		((static_cast<uint64_t>(static_cast<uint32_t>(cell.z)) & 0xFFFFFF) << 16) |
+		(static_cast<uint64_t>(static_cast<uint32_t>(cell.y)) & 0xFFFF);
+	return std::hash<uint64_t>{}(key);
+}
+
+void World::onPositionBlockIdConstruct(const Registry& registry, const Entity entity)
+{
+	world_dirty = true;
+	// only operate when both components have been removed
+	if (!registry.all_of<BlockId, Position>(entity)) return;
+
+	journalEdit({EditJournal::Edit::Type::PlaceEntity, registry.get<BlockId>(entity), {}, registry.get<Position>(entity).vec3});
+	addInstance(registry.get<BlockId>(entity), entity, registry.get<Position>(entity).vec3);
+}
+
+void World::onPositionBlockIdDestruct(const Registry& registry, const Entity entity)
+{
+	world_dirty = true;
+	// only operate when both components have been removed
+	if (!registry.all_of<BlockId, Position>(entity)) return;
+
+	journalEdit({EditJournal::Edit::Type::DestroyEntity, registry.get<BlockId>(entity), {}, registry.get<Position>(entity).vec3});
+	removeInstance(registry.get<BlockId>(entity), entity, registry.get<Position>(entity).vec3);
 }
 
 void World::connect() {
@@ -282,65 +1238,203 @@ void World::disconnect() {
 	connections.clear();
 }
 
-void World::initInstancingBuffers() {
-	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
-		updateInstancingBuffers(BlockId(i), false, 0, true);
-	}
-}
-
-void World::updateInstancingBuffers(const BlockId id, const bool new_data, const size_t index, const bool force_copy) {
-	if (!force_copy && new_data && (instancing_models[id.uint()].size() <= index)) { return; }
-
-	for (unsigned int i = 0; i < (unsigned int)num_unique_buffers; i++) {
-		auto lambda = [=]<typename T>(const std::vector<T>& vec, GLuint buffer) {
-			using ElemType = std::remove_cvref_t<decltype(vec)>::value_type;
-			constexpr size_t elem_size = sizeof(ElemType);
-			size_t vec_capacity_bytes = vec.capacity() * elem_size;
-			size_t vec_size_bytes = vec.size() * elem_size;
-			void* const data = (void*)vec.data();
-
-			GLint buffer_size;
-			glGetNamedBufferParameteriv(buffer, GL_BUFFER_SIZE, &buffer_size);
-			// an empty buffer object causes errors when binding to a VAO
-			if ((static_cast<size_t>(buffer_size) != elem_size) && (vec_capacity_bytes == 0)) {
-				glNamedBufferData(buffer, elem_size, NULL, GL_DYNAMIC_DRAW);
-			// resize following std::vector's amortized complexity
-			} else if ((vec_capacity_bytes != 0) && (force_copy || (vec_capacity_bytes != static_cast<size_t>(buffer_size)))) {
-				glNamedBufferData(buffer, vec_capacity_bytes, NULL, GL_DYNAMIC_DRAW);
-				glNamedBufferSubData(buffer, 0, vec_size_bytes, data);
-			} else if (new_data) {
-				GLintptr offset = index * elem_size;
-				glNamedBufferSubData(buffer, offset, elem_size, (void*)((char*)data + offset));
-			}
-		};
+void World::reserveCulledInstances() {
+	if (culling_mode != CullingMode::Gpu) return;
 
-		lambda(instancing_models[id.uint()], instancing_model_buffers[id.uint()]);
-		lambda(instancing_normal_mats[id.uint()], instancing_normal_mat_buffers[id.uint()]);
+	size_t max_instances = 0;
+	for (const std::vector<Instance>& instance_vec : instances) {
+		max_instances = std::max(max_instances, instance_vec.size());
+	}
+	gpu_culler->reserve(max_instances);
+}
+
+void World::flushInstancingBuffers() {
+	reserveCulledInstances();
 
+	for (unsigned int i = 0; i < BlockId::NumNames; i++) {
+		if (!instance_buffers[i].flush(instances[i])) continue;
+
+		// the bucket changed so its bounds may have too
+		Bounds& bounds = instance_bounds[i];
+		bounds = Bounds{};
+		for (const Instance& instance : instances[i]) {
+			bounds.min = glm::min(bounds.min, instance.position() - block_half_length);
+			bounds.max = glm::max(bounds.max, instance.position() + block_half_length);
+		}
 	}
 }
 
 void World::initInstancingData() {
-	for (unsigned int i = 0; i < instancing_models.size(); i++) {
-		instancing_models[i].clear();
-		instancing_models.shrink_to_fit();
-		instancing_normal_mats[i].clear();
-		instancing_normal_mats[i].shrink_to_fit();
+	const auto view = world_registry.view<Position, BlockId>();
+	std::vector<Entity> entities;
+	entities.reserve(view.size_hint());
+	for (const Entity entity : view) {
+		entities.push_back(entity);
 	}
 
-	const auto view = world_registry.view<Position, BlockId>();
-	for (Entity entity : view) {
-		const glm::vec3& pos = view.get<Position>(entity).vec3;
-		const BlockId id = view.get<BlockId>(entity);
-		glm::mat4 model = glm::mat4(1.0);
-		model = glm::translate(model, pos);
+	// each thread takes one contiguous range, small worlds aren't worth the threads
+	const size_t num_names = instances.size();
+	const size_t num_ranges = std::clamp<size_t>(entities.size() / min_instance_range, 1, std::max(1u, std::thread::hardware_concurrency()));
+	auto range_begin = [&](const size_t range) {
+		return (entities.size() * range) / num_ranges;
+	};
+
+	// count every bucket first so nothing reallocates while the buckets fill
+	std::vector<size_t> offsets(num_ranges * num_names, 0);
+	std::vector<size_t> max_numbers(num_ranges, 0);
+	utils::parallelFor(num_ranges, [&](const size_t range) {
+		for (size_t i = range_begin(range); i < range_begin(range + 1); i++) {
+			offsets[(range * num_names) + view.get<BlockId>(entities[i]).uint()]++;
+			max_numbers[range] = std::max(max_numbers[range], static_cast<size_t>(entt::to_entity(entities[i])));
+		}
+	});
+	// turn counts into where each range starts writing in each bucket
+	std::vector<std::vector<glm::vec3>> positions(num_names);
+	for (size_t id = 0; id < num_names; id++) {
+		size_t total = 0;
+		for (size_t range = 0; range < num_ranges; range++) {
+			total += std::exchange(offsets[(range * num_names) + id], total);
+		}
+		positions[id].resize(total);
+		instances[id].clear();
+		instances[id].resize(total);
+		instances[id].shrink_to_fit();
+		instance_entities[id].clear();
+		instance_entities[id].resize(total);
+		instance_entities[id].shrink_to_fit();
+	}
+	instance_slots.assign(entities.empty() ? 0 : (*std::max_element(max_numbers.begin(), max_numbers.end()) + 1), 0);
+
+	// ranges write to disjoint slots, and every entity number is unique so instance_slots doesn't race either
+	utils::parallelFor(num_ranges, [&](const size_t range) {
+		std::vector<size_t> begin(offsets.begin() + (range * num_names), offsets.begin() + ((range + 1) * num_names));
+		size_t* const next = offsets.data() + (range * num_names);
+		for (size_t i = range_begin(range); i < range_begin(range + 1); i++) {
+			const unsigned int id = view.get<BlockId>(entities[i]).uint();
+			const size_t slot = next[id]++;
+			positions[id][slot] = view.get<Position>(entities[i]).vec3;
+			instance_entities[id][slot] = entities[i];
+			instance_slots[static_cast<size_t>(entt::to_entity(entities[i]))] = slot;
+		}
+		// build instances in bulk, matrix instances run through the batch normal matrix kernel
+		for (size_t id = 0; id < num_names; id++) {
+			Instance::fromPositions(positions[id].data() + begin[id], instances[id].data() + begin[id], next[id] - begin[id]);
+		}
+	});
 
-		instancing_models[id.uint()].push_back(std::move(model));
-		instancing_normal_mats[id.uint()].push_back(glm::mat3(1.0f));
+	// the cell index is a hash map, so it is filled on this thread
+	cell_entities.clear();
+	cell_entities.reserve(entities.size());
+	for (size_t id = 0; id < num_names; id++) {
+		for (size_t slot = 0; slot < positions[id].size(); slot++) {
+			cell_entities.insert_or_assign(instanceCell(positions[id][slot]), instance_entities[id][slot]);
+		}
 	}
 }
 
+std::string World::bakeInstances(const uint32_t source_hash) const
+{
+	// header, bucket sizes, then every bucket's instances and every bucket's entity numbers
+	std::vector<uint32_t> counts(instances.size());
+	size_t total = 0;
+	for (size_t id = 0; id < instances.size(); id++) {
+		counts[id] = static_cast<uint32_t>(instances[id].size());
+		total += instances[id].size();
+	}
+	std::string bytes(sizeof(CacheHeader) + (counts.size() * sizeof(uint32_t)) + (total * (sizeof(Instance) + sizeof(uint32_t))), '\0');
+	size_t pos = sizeof(CacheHeader);
+	std::memcpy(bytes.data() + pos, counts.data(), counts.size() * sizeof(uint32_t));
+	pos += counts.size() * sizeof(uint32_t);
+	for (const std::vector<Instance>& bucket : instances) {
+		std::memcpy(bytes.data() + pos, bucket.data(), bucket.size() * sizeof(Instance));
+		pos += bucket.size() * sizeof(Instance);
+	}
+	for (const std::vector<Entity>& bucket : instance_entities) {
+		for (const Entity entity : bucket) {
+			const uint32_t number = static_cast<uint32_t>(entt::to_entity(entity));
+			std::memcpy(bytes.data() + pos, &number, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+		}
+	}
+
+	const CacheHeader header{cache_magic, save_version, sizeof(Instance), static_cast<uint32_t>(instances.size()), source_hash,
+		utils::crc32(bytes.data() + sizeof(CacheHeader), bytes.size() - sizeof(CacheHeader))};
+	std::memcpy(bytes.data(), &header, sizeof(CacheHeader));
+	return bytes;
+}
+
+bool World::loadBakedInstances(const std::vector<Entity>& remap, const uint32_t source_hash)
+{
+	std::ifstream stream(instance_cache_path, std::ios::in | std::ios::binary);
+	if (!stream) return false;
+	const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+
+	// any mismatch just means a rebuild, the cache is never the only copy of anything
+	CacheHeader header;
+	const size_t counts_size = instances.size() * sizeof(uint32_t);
+	if (bytes.size() < (sizeof(CacheHeader) + counts_size)) return false;
+	std::memcpy(&header, bytes.data(), sizeof(CacheHeader));
+	if ((header.magic != cache_magic) || (header.version != save_version) || (header.instance_size != sizeof(Instance))
+		|| (header.num_buckets != instances.size()) || (header.source_hash != source_hash)
+		|| (utils::crc32(bytes.data() + sizeof(CacheHeader), bytes.size() - sizeof(CacheHeader)) != header.crc)) return false;
+
+	std::vector<uint32_t> counts(instances.size());
+	std::memcpy(counts.data(), bytes.data() + sizeof(CacheHeader), counts_size);
+	size_t total = 0;
+	for (const uint32_t count : counts) {
+		total += count;
+	}
+	if (bytes.size() != (sizeof(CacheHeader) + counts_size + (total * (sizeof(Instance) + sizeof(uint32_t))))) return false;
+
+	// entity numbers have to name entities the pools just created
+	const uint8_t* numbers = bytes.data() + sizeof(CacheHeader) + counts_size + (total * sizeof(Instance));
+	std::vector<Entity> entities(total);
+	size_t max_number = 0;
+	for (size_t i = 0; i < total; i++) {
+		uint32_t number = 0;
+		std::memcpy(&number, numbers + (i * sizeof(uint32_t)), sizeof(uint32_t));
+		if ((number >= remap.size()) || (remap[number] == entt::null)) return false;
+
+		entities[i] = remap[number];
+		max_number = std::max(max_number, static_cast<size_t>(entt::to_entity(entities[i])));
+	}
+
+	const uint8_t* data = bytes.data() + sizeof(CacheHeader) + counts_size;
+	instance_slots.assign(total ? (max_number + 1) : 0, 0);
+	cell_entities.clear();
+	cell_entities.reserve(total);
+	for (size_t id = 0, first = 0; id < instances.size(); id++) {
+		instances[id].resize(counts[id]);
+		instances[id].shrink_to_fit();
+		std::memcpy(static_cast<void*>(instances[id].data()), data, counts[id] * sizeof(Instance));
+		data += counts[id] * sizeof(Instance);
+		instance_entities[id].assign(entities.begin() + first, entities.begin() + first + counts[id]);
+		instance_entities[id].shrink_to_fit();
+		for (size_t slot = 0; slot < counts[id]; slot++) {
+			const Entity entity = instance_entities[id][slot];
+			instance_slots[static_cast<size_t>(entt::to_entity(entity))] = slot;
+			cell_entities.insert_or_assign(instanceCell(instances[id][slot].position()), entity);
+		}
+		first += counts[id];
+	}
+	return true;
+}
+
 void World::initData() {
-	initInstancingData();
-	initInstancingBuffers();
+	// a matching instance cache already filled the buckets
+	if (!std::exchange(instances_baked, false)) {
+		initInstancingData();
+	}
+	for (InstanceBuffer& buffer : instance_buffers) {
+		buffer.markAllDirty();
+	}
+	flushInstancingBuffers();
+
+	chunk_meshes.clear();
+	mesh_keys.clear();
+	chunk_lods.clear();
+	for (const auto& [coord, chunk] : chunks) {
+		queueRemesh(coord, false);
+	}
+	remeshChunks();
 }
\ No newline at end of file
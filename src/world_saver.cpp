@@ -0,0 +1,173 @@
+#include "world_saver.h"
+
+#include "region_store.h"
+#include "utils.h"
+
+#include <string>
+#include <optional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+#include <cstddef>
+
+WorldSaver::WorldSaver(const RegionStore& region_store, const std::string& world_path, const std::string& cache_path) :
+	region_store(region_store),
+	world_path(world_path),
+	cache_path(cache_path),
+	worker(&WorldSaver::run, this)
+{}
+
+WorldSaver::~WorldSaver()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+void WorldSaver::save(Snapshot&& snapshot)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		// snapshots only hold what changed, so a queued one is merged rather than dropped
+		merge(queued, std::move(snapshot));
+	}
+	condition.notify_all();
+}
+
+void WorldSaver::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]() { return !queued && !writing; });
+}
+
+bool WorldSaver::busy() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return queued || writing;
+}
+
+WorldSaver::Stats WorldSaver::getStats() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+std::optional<WorldSaver::Snapshot> WorldSaver::takeFailed()
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return std::exchange(failed, std::nullopt);
+}
+
+void WorldSaver::merge(std::optional<Snapshot>& into, Snapshot&& snapshot)
+{
+	if (!into) {
+		into = std::move(snapshot);
+		return;
+	}
+
+	if (!snapshot.world_bytes.empty()) {
+		into->world_bytes = std::move(snapshot.world_bytes);
+		into->cache_bytes = std::move(snapshot.cache_bytes);
+	}
+	std::unordered_map<ChunkCoord, size_t> indices;
+	for (size_t i = 0; i < into->chunks.size(); i++) {
+		indices.emplace(into->chunks[i].first, i);
+	}
+	for (auto& chunk : snapshot.chunks) {
+		const auto it = indices.find(chunk.first);
+		if (it == indices.end()) {
+			into->chunks.push_back(std::move(chunk));
+		} else {
+			into->chunks[it->second] = std::move(chunk);
+		}
+	}
+}
+
+void WorldSaver::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [this]() { return queued || stopping; });
+		// stopping still writes whatever is queued, that is the final save on shutdown
+		if (!queued) return;
+
+		Snapshot snapshot = std::move(*queued);
+		queued.reset();
+		writing = true;
+		lock.unlock();
+
+		const Stats result = write(snapshot);
+
+		lock.lock();
+		stats = result;
+		if (!result.success) {
+			merge(failed, std::move(snapshot));
+		}
+		writing = false;
+		condition.notify_all();
+	}
+}
+
+WorldSaver::Stats WorldSaver::write(const Snapshot& snapshot) const
+{
+	const auto start = std::chrono::steady_clock::now();
+	Stats result;
+	result.num_chunks = snapshot.chunks.size();
+
+	size_t region_bytes = 0;
+	result.success = region_store.save(snapshot.chunks, region_bytes);
+	result.bytes_written += region_bytes;
+
+	// world.bin names the journals this save covers, so it only goes out once the chunks are on disk
+	// nothing but chunks changed if it is empty, the old file is still current
+	if (result.success && !snapshot.world_bytes.empty()) {
+		result.success = replaceFile(world_path, snapshot.world_bytes, true);
+		if (result.success) {
+			result.bytes_written += snapshot.world_bytes.size();
+		}
+	}
+	// the cache carries a hash of world.bin, a cache that didn't get written is just ignored on load
+	if (result.success && !snapshot.cache_bytes.empty() && replaceFile(cache_path, snapshot.cache_bytes, false)) {
+		result.bytes_written += snapshot.cache_bytes.size();
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+bool WorldSaver::replaceFile(const std::string& path, const std::string& bytes, const bool sync)
+{
+	// written beside the old file and swapped in, so a crash mid save keeps the previous one
+	const std::string temp_path = path + ".tmp";
+	bool success = true;
+	{
+		std::ofstream stream(temp_path, std::ios::out | std::ios::trunc | std::ios::binary);
+		stream.write(bytes.data(), bytes.size());
+		success = static_cast<bool>(stream);
+	}
+	if (success && sync) {
+		success = utils::syncFile(temp_path);
+	}
+	std::error_code error;
+	if (success) {
+		std::filesystem::rename(temp_path, path, error);
+		success = !error;
+	}
+	if (success && sync) {
+		// a lost rename would bring back the old file, which can name journals that were already dropped
+		success = utils::syncDirectory(std::filesystem::path(path).parent_path().string());
+	}
+	if (!success) {
+		LOG("Unable to write " << path)
+	}
+	return success;
+}
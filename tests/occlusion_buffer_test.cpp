@@ -0,0 +1,55 @@
+#include "occlusion_buffer.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/trigonometric.hpp"
+#include "glm/ext/matrix_clip_space.hpp"
+#include "glm/ext/matrix_transform.hpp"
+
+#include <iostream>
+
+// rasterizes a wall in front of a camera at the origin looking down -z and checks boxes around it
+// built once with the simd loops and once with OCCLUSION_BUFFER_SCALAR, both have to give the same answers
+namespace
+{
+	int num_failed = 0;
+
+	void check(const bool passed, const char* name)
+	{
+		std::cout << (passed ? "pass " : "FAIL ") << name << '\n';
+		num_failed += !passed;
+	}
+
+	glm::mat4 viewProjection()
+	{
+		// same aspect as the buffer so a pixel is square
+		const float aspect = static_cast<float>(OcclusionBuffer::default_width) / OcclusionBuffer::default_height;
+		const glm::mat4 projection = glm::perspective(glm::radians(90.0f), aspect, 0.1f, 100.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		return projection * view;
+	}
+}
+
+int main()
+{
+	OcclusionBuffer buffer;
+	buffer.begin(viewProjection());
+	check(buffer.isVisible(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, -20.0f)), "nothing hides a box in an empty buffer");
+
+	// edges off the lane grid so the simd steps and the scalar tails both cover part of it
+	check(buffer.addOccluder(glm::vec3(-4.3f, -4.0f, -11.0f), glm::vec3(4.3f, 4.0f, -10.0f)), "wall is rasterized");
+	check(!buffer.addOccluder(glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 1.0f)), "box around the camera is skipped");
+
+	check(!buffer.isVisible(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, -20.0f)), "box behind the wall is hidden");
+	check(!buffer.isVisible(glm::vec3(-7.7f, -7.0f, -30.0f), glm::vec3(7.7f, 7.0f, -22.0f)), "wide box far behind the wall is hidden");
+	check(buffer.isVisible(glm::vec3(-1.0f, -1.0f, -6.0f), glm::vec3(1.0f, 1.0f, -5.0f)), "box in front of the wall is visible");
+	check(buffer.isVisible(glm::vec3(6.0f, -1.0f, -21.0f), glm::vec3(12.0f, 1.0f, -20.0f)), "box partly behind the wall is visible");
+	check(buffer.isVisible(glm::vec3(-1.0f, 5.0f, -21.0f), glm::vec3(1.0f, 12.0f, -20.0f)), "box above the wall is visible");
+	check(buffer.isVisible(glm::vec3(-1.0f, -1.0f, -10.5f), glm::vec3(1.0f, 1.0f, -5.0f)), "box reaching in front of the wall is visible");
+	check(buffer.isVisible(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, 1.0f)), "box crossing the near plane is visible");
+
+	buffer.begin(viewProjection());
+	check(buffer.isVisible(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, -20.0f)), "begin clears the previous occluders");
+
+	return (num_failed == 0) ? 0 : 1;
+}